@@ -12,12 +12,100 @@
 #include <iomanip>
 #include <sstream>
 #include <fstream>
+#include <cstring>
+#include <cstdint>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <cerrno>
+#include <cmath>
+#include <cstdlib>
+#include <functional>
+#include <iterator>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <thread>
+
+#include <dirent.h>
+#include <elf.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <sys/uio.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define RLE_HAVE_X86 1 ///< Set when the x86 SIMD decode kernels can be compiled.
+#endif
 
 GtkBuilder *builder;          ///< GTK builder for loading the GUI from the Glade file.
 GtkWidget *main_window;       ///< Main application window.
 GtkWidget *about_window;      ///< About dialog window.
 GtkWidget *text_entry;        ///< Text entry widget for input/output text.
 
+std::vector<unsigned char> text_result; ///< Encoded bytes behind the hex shown in the text entry.
+size_t text_result_rendered = 0;        ///< Bytes of text_result currently rendered as hex.
+bool text_result_active = false;        ///< Whether the text entry still shows text_result unmodified.
+bool text_result_rendering = false;     ///< Set while lazy rendering changes the text entry.
+
+#ifdef RLE_HAVE_X86
+/**
+ * @brief Convert the leading whole 16-byte blocks of a buffer to hex with SSSE3.
+ * 
+ * @param bytes Pointer to the bytes.
+ * @param size Number of bytes.
+ * @param hex Output buffer of 2 * size characters.
+ * @return Number of bytes converted.
+ */
+__attribute__((target("ssse3")))
+static size_t bytes_to_hex_ssse3(const unsigned char *bytes, size_t size, char *hex) {
+    const __m128i digits = _mm_setr_epi8('0', '1', '2', '3', '4', '5', '6', '7',
+                                         '8', '9', 'a', 'b', 'c', 'd', 'e', 'f');
+    const __m128i low_nibble = _mm_set1_epi8(0x0f);
+    size_t i = 0;
+
+    for (; i + 16 <= size; i += 16) {
+        __m128i value = _mm_loadu_si128(reinterpret_cast<const __m128i*>(bytes + i));
+        __m128i high = _mm_shuffle_epi8(digits, _mm_and_si128(_mm_srli_epi16(value, 4), low_nibble));
+        __m128i low = _mm_shuffle_epi8(digits, _mm_and_si128(value, low_nibble));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(hex + 2 * i), _mm_unpacklo_epi8(high, low));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(hex + 2 * i + 16), _mm_unpackhi_epi8(high, low));
+    }
+
+    return i;
+}
+#endif
+
+/**
+ * @brief Convert bytes to lowercase hex digits.
+ * 
+ * @param bytes Pointer to the bytes.
+ * @param size Number of bytes.
+ * @param hex Output buffer of 2 * size characters.
+ */
+void bytes_to_hex_into(const unsigned char *bytes, size_t size, char *hex) {
+    static const char digits[] = "0123456789abcdef";
+    size_t i = 0;
+
+#ifdef RLE_HAVE_X86
+    static const bool has_ssse3 = __builtin_cpu_supports("ssse3");
+    if (has_ssse3) {
+        i = bytes_to_hex_ssse3(bytes, size, hex);
+    }
+#endif
+    for (; i < size; ++i) {
+        hex[2 * i] = digits[bytes[i] >> 4];
+        hex[2 * i + 1] = digits[bytes[i] & 0x0f];
+    }
+}
+
 /**
  * @brief Convert a vector of bytes to a hex string.
  * 
@@ -25,246 +113,5221 @@ GtkWidget *text_entry;        ///< Text entry widget for input/output text.
  * @return Hex string representation of the bytes.
  */
 std::string bytes_to_hex(const std::vector<unsigned char>& bytes) {
-    std::stringstream ss;
-    ss << std::hex << std::setfill('0');
-    
-    for (unsigned char byte : bytes) {
-        ss << std::setw(2) << static_cast<unsigned>(byte);
+    std::string hex(2 * bytes.size(), '0');
+    bytes_to_hex_into(bytes.data(), bytes.size(), &hex[0]);
+    return hex;
+}
+
+/**
+ * @brief Convert hex digits of either case to bytes.
+ * 
+ * @param hex Pointer to 2 * size hex digits.
+ * @param size Number of bytes to produce.
+ * @param bytes Output buffer of size bytes.
+ * @return True if every character was a hex digit.
+ */
+bool hex_to_bytes_into(const char *hex, size_t size, unsigned char *bytes) {
+    static const struct hex_table {
+        signed char value[256];
+
+        hex_table() {
+            std::memset(value, -1, sizeof(value));
+            for (int d = 0; d < 10; ++d) {
+                value['0' + d] = d;
+            }
+            for (int d = 0; d < 6; ++d) {
+                value['a' + d] = value['A' + d] = 10 + d;
+            }
+        }
+    } table;
+    int invalid = 0;
+
+    for (size_t i = 0; i < size; ++i) {
+        int high = table.value[static_cast<unsigned char>(hex[2 * i])];
+        int low = table.value[static_cast<unsigned char>(hex[2 * i + 1])];
+        invalid |= high | low;
+        bytes[i] = static_cast<unsigned char>(((high & 0x0f) << 4) | (low & 0x0f));
     }
-    
-    return ss.str();
+
+    return invalid >= 0;
 }
 
 /**
  * @brief Convert a hex string to a vector of bytes.
  * 
+ * A trailing unpaired digit is ignored.
+ * 
  * @param hex Hex string to convert.
- * @return Vector of bytes represented by the hex string.
+ * @return Vector of bytes represented by the hex string, empty if it holds a non-hex character.
  */
 std::vector<unsigned char> hex_to_bytes(const std::string& hex) {
-    std::vector<unsigned char> bytes;
+    std::vector<unsigned char> bytes(hex.length() / 2);
     
-    for (size_t i = 0; i < hex.length(); i += 2) {
-        unsigned byte;
-        std::istringstream(hex.substr(i, 2)) >> std::hex >> byte;
-        bytes.push_back(static_cast<unsigned char>(byte));
+    if (!hex_to_bytes_into(hex.data(), bytes.size(), bytes.data())) {
+        bytes.clear();
     }
     
     return bytes;
 }
 
+static const char RLE_BASE64_DIGITS[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/"; ///< Base64 alphabet.
+
 /**
- * @brief Encode data using Run-Length Encoding (RLE).
+ * @brief Convert bytes to padded Base64.
  * 
- * @param data Vector of bytes to encode.
- * @return RLE encoded vector of bytes.
+ * @param bytes Pointer to the bytes.
+ * @param size Number of bytes.
+ * @param text Output buffer of 4 * ceil(size / 3) characters.
+ * @return Number of characters written.
  */
-std::vector<unsigned char> encode_rle(const std::vector<unsigned char>& data) {
-    std::vector<unsigned char> encoded;
-    size_t count = 1;
-    
-    for (size_t i = 1; i <= data.size(); ++i) {
-        if (i == data.size() || data[i] != data[i - 1]) {
-            encoded.push_back(count);
-            encoded.push_back(data[i - 1]);
-            count = 1;
-        } else {
-            ++count;
-        }
+size_t bytes_to_base64_into(const unsigned char *bytes, size_t size, char *text) {
+    char *out = text;
+    size_t i = 0;
+
+    for (; i + 3 <= size; i += 3) {
+        uint32_t group = (bytes[i] << 16) | (bytes[i + 1] << 8) | bytes[i + 2];
+        out[0] = RLE_BASE64_DIGITS[group >> 18];
+        out[1] = RLE_BASE64_DIGITS[(group >> 12) & 0x3f];
+        out[2] = RLE_BASE64_DIGITS[(group >> 6) & 0x3f];
+        out[3] = RLE_BASE64_DIGITS[group & 0x3f];
+        out += 4;
     }
-    
-    return encoded;
+    if (i < size) {
+        uint32_t group = (bytes[i] << 16) | ((i + 1 < size) ? bytes[i + 1] << 8 : 0);
+        out[0] = RLE_BASE64_DIGITS[group >> 18];
+        out[1] = RLE_BASE64_DIGITS[(group >> 12) & 0x3f];
+        out[2] = (i + 1 < size) ? RLE_BASE64_DIGITS[(group >> 6) & 0x3f] : '=';
+        out[3] = '=';
+        out += 4;
+    }
+
+    return out - text;
 }
 
 /**
- * @brief Decode data from Run-Length Encoding (RLE).
+ * @brief Convert padded Base64 to bytes.
  * 
- * @param encoded RLE encoded vector of bytes.
- * @return Decoded vector of bytes.
+ * Padding is only accepted in the last group.
+ * 
+ * @param text Pointer to the characters, a multiple of 4.
+ * @param size Number of characters.
+ * @param bytes Output buffer of 3 * size / 4 bytes.
+ * @param written Number of bytes produced.
+ * @return True if the text was valid Base64.
  */
-std::vector<unsigned char> decode_rle(const std::vector<unsigned char>& encoded) {
-    std::vector<unsigned char> decoded;
-    
-    for (size_t i = 0; i < encoded.size(); i += 2) {
-        unsigned char count = encoded[i];
-        unsigned char byte = encoded[i + 1];
-        
-        for (int j = 0; j < count; ++j) {
-            decoded.push_back(byte);
+bool base64_to_bytes_into(const char *text, size_t size, unsigned char *bytes, size_t& written) {
+    static const struct base64_table {
+        signed char value[256];
+
+        base64_table() {
+            std::memset(value, -1, sizeof(value));
+            for (int d = 0; d < 64; ++d) {
+                value[static_cast<unsigned char>(RLE_BASE64_DIGITS[d])] = d;
+            }
         }
+    } table;
+
+    if (size % 4 != 0) {
+        return false;
     }
-    
-    return decoded;
+
+    size_t padding = 0;
+    if (size != 0 && text[size - 1] == '=') {
+        padding = (text[size - 2] == '=') ? 2 : 1;
+    }
+
+    int invalid = 0;
+    unsigned char *out = bytes;
+    for (size_t i = 0; i < size; i += 4) {
+        int d0 = table.value[static_cast<unsigned char>(text[i])];
+        int d1 = table.value[static_cast<unsigned char>(text[i + 1])];
+        int d2 = (i + 4 == size && padding == 2) ? 0 : table.value[static_cast<unsigned char>(text[i + 2])];
+        int d3 = (i + 4 == size && padding != 0) ? 0 : table.value[static_cast<unsigned char>(text[i + 3])];
+        invalid |= d0 | d1 | d2 | d3;
+        uint32_t group = ((d0 & 0x3f) << 18) | ((d1 & 0x3f) << 12) | ((d2 & 0x3f) << 6) | (d3 & 0x3f);
+        out[0] = static_cast<unsigned char>(group >> 16);
+        out[1] = static_cast<unsigned char>(group >> 8);
+        out[2] = static_cast<unsigned char>(group);
+        out += 3;
+    }
+
+    written = out - bytes - padding;
+    return invalid >= 0;
 }
 
+static const size_t RLE_MAX_RUN = 255; ///< Longest run a single count byte can hold.
+
 /**
- * @brief Encode input text using RLE and convert to hex string.
+ * @brief Compute the size of the RLE encoding of a buffer.
  * 
- * @param input Input text string.
- * @return Hex string of the RLE encoded input text.
+ * @param in Pointer to the bytes to encode.
+ * @param size Number of bytes.
+ * @return Number of encoded bytes.
  */
-std::string encode_rle_hex(const std::string& input) {
-    std::vector<unsigned char> data(input.begin(), input.end());
-    std::vector<unsigned char> encoded = encode_rle(data);
-    return bytes_to_hex(encoded);
+size_t rle_encoded_size(const unsigned char *in, size_t size) {
+    size_t encoded = 0;
+
+    for (size_t i = 0; i < size;) {
+        size_t run = 1;
+        while (i + run < size && in[i + run] == in[i] && run < RLE_MAX_RUN) {
+            ++run;
+        }
+        encoded += 2;
+        i += run;
+    }
+
+    return encoded;
 }
 
 /**
- * @brief Decode hex string from RLE encoding.
+ * @brief Encode a buffer with RLE into a preallocated buffer.
  * 
- * @param hex Hex string of RLE encoded data.
- * @return Decoded text string.
+ * Runs longer than RLE_MAX_RUN are split into several pairs.
+ * 
+ * @param in Pointer to the bytes to encode.
+ * @param size Number of bytes.
+ * @param out Output buffer, at least rle_encoded_size() bytes long.
+ * @return Number of encoded bytes.
  */
-std::string decode_rle_hex(const std::string& hex) {
-    std::vector<unsigned char> encoded = hex_to_bytes(hex);
-    std::vector<unsigned char> decoded = decode_rle(encoded);
-    return std::string(decoded.begin(), decoded.end());
+size_t encode_rle_into(const unsigned char *in, size_t size, unsigned char *out) {
+    unsigned char *start = out;
+
+    for (size_t i = 0; i < size;) {
+        size_t run = 1;
+        while (i + run < size && in[i + run] == in[i] && run < RLE_MAX_RUN) {
+            ++run;
+        }
+        out[0] = static_cast<unsigned char>(run);
+        out[1] = in[i];
+        out += 2;
+        i += run;
+    }
+
+    return out - start;
 }
 
 /**
- * @brief Callback function for the About button click event.
+ * @brief Encode data using Run-Length Encoding (RLE).
  * 
- * @param button GTK button that was clicked.
- * @param user_data User data passed to the callback function.
+ * @param data Vector of bytes to encode.
+ * @return RLE encoded vector of bytes.
  */
-void on_about_clicked(GtkButton *button, gpointer user_data) {
-    GtkWidget *about_window = GTK_WIDGET(user_data);
-    gtk_widget_show_all(about_window);
+std::vector<unsigned char> encode_rle(const std::vector<unsigned char>& data) {
+    std::vector<unsigned char> encoded(rle_encoded_size(data.data(), data.size()));
+    encode_rle_into(data.data(), data.size(), encoded.data());
+    return encoded;
 }
 
 /**
- * @brief Perform text encoding or decoding action based on action type.
+ * @brief When a streaming encoder closes its open run and emits a segment.
  * 
- * @param action_type Action type: 0 for encoding, 1 for decoding.
- * @param text_entry_widget GTK text entry widget containing the text.
+ * Limits set to zero are disabled. The emitted segments are plain RLE pair
+ * streams, so their concatenation decodes to the original data.
  */
-void text_action(int action_type, GtkWidget *text_entry_widget) {
-    const gchar *text = gtk_entry_get_text(GTK_ENTRY(text_entry_widget));
-    std::string input_text = text;
-    std::string result_text;
+struct rle_flush_policy {
+    size_t max_held_bytes = 0;                  ///< Flush once this many input bytes are held.
+    std::chrono::milliseconds max_hold_time{0}; ///< Flush once the oldest held byte is this old.
+};
 
-    if (action_type == 0) {
-        result_text = encode_rle_hex(input_text);
-    } else if (action_type == 1) {
-        result_text = decode_rle_hex(input_text);
-    } else {
-        g_printerr("Invalid action type.\n");
-        return;
+/**
+ * @brief Incremental RLE encoder passing encoded segments to a sink.
+ * 
+ * Encoded pairs are buffered until a flush, or until RLE_STREAM_BUFFER
+ * bytes have accumulated. A run that may still continue is held open until
+ * the flush policy closes it. With max_hold_time set, the caller must call
+ * poll() regularly; latency is then bounded by max_hold_time plus the poll
+ * interval.
+ */
+class rle_stream_encoder {
+public:
+    typedef std::function<void(const unsigned char *, size_t)> sink_type; ///< Receiver of encoded bytes.
+
+    /**
+     * @brief Create a streaming encoder.
+     * 
+     * @param sink Function receiving the encoded bytes.
+     * @param policy Flush policy.
+     */
+    rle_stream_encoder(sink_type sink, rle_flush_policy policy = rle_flush_policy())
+        : sink(std::move(sink)), policy(policy) {
     }
 
-    gtk_entry_set_text(GTK_ENTRY(text_entry_widget), result_text.c_str());
-}
+    /**
+     * @brief Encode more input.
+     * 
+     * @param data Pointer to the input bytes.
+     * @param size Number of input bytes.
+     */
+    void write(const unsigned char *data, size_t size) {
+        if (size == 0) {
+            return;
+        }
+        if (held_bytes == 0) {
+            held_since = std::chrono::steady_clock::now();
+        }
+
+        for (size_t i = 0; i < size;) {
+            if (run_count == RLE_MAX_RUN || (run_count > 0 && data[i] != run_byte)) {
+                close_run();
+            }
+            if (run_count == 0) {
+                run_byte = data[i];
+            }
+
+            size_t run = 0;
+            size_t room = RLE_MAX_RUN - run_count;
+            while (i + run < size && run < room && data[i + run] == run_byte) {
+                ++run;
+            }
+            run_count += run;
+            i += run;
+        }
+
+        held_bytes += size;
+        if (policy.max_held_bytes != 0 && held_bytes >= policy.max_held_bytes) {
+            flush();
+        } else {
+            poll();
+        }
+    }
+
+    /**
+     * @brief Flush if the oldest held byte has exceeded max_hold_time.
+     */
+    void poll() {
+        if (held_bytes != 0 && policy.max_hold_time.count() != 0 &&
+            std::chrono::steady_clock::now() - held_since >= policy.max_hold_time) {
+            flush();
+        }
+    }
+
+    /**
+     * @brief Get the time left before poll() flushes the held input.
+     * 
+     * @return Milliseconds left, or -1 if nothing is held or no time limit is set.
+     */
+    long long flush_delay() const {
+        if (held_bytes == 0 || policy.max_hold_time.count() == 0) {
+            return -1;
+        }
+        auto held = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - held_since);
+        return std::max<long long>(0, (policy.max_hold_time - held).count());
+    }
+
+    /**
+     * @brief Close the open run and emit everything encoded so far.
+     */
+    void flush() {
+        close_run();
+        emit();
+        held_bytes = 0;
+    }
+
+private:
+    static const size_t RLE_STREAM_BUFFER = 1 << 16; ///< Encoded bytes buffered before emitting.
+
+    /**
+     * @brief Append the open run to the buffer, if there is one.
+     */
+    void close_run() {
+        if (run_count == 0) {
+            return;
+        }
+        buffer.push_back(static_cast<unsigned char>(run_count));
+        buffer.push_back(run_byte);
+        run_count = 0;
+        if (buffer.size() >= RLE_STREAM_BUFFER) {
+            emit();
+        }
+    }
+
+    /**
+     * @brief Pass the buffered pairs to the sink.
+     */
+    void emit() {
+        if (!buffer.empty()) {
+            sink(buffer.data(), buffer.size());
+            buffer.clear();
+        }
+    }
+
+    sink_type sink;                                   ///< Receiver of encoded bytes.
+    rle_flush_policy policy;                          ///< Flush policy.
+    std::vector<unsigned char> buffer;                ///< Encoded pairs not yet emitted.
+    unsigned char run_byte = 0;                       ///< Byte of the open run.
+    size_t run_count = 0;                             ///< Length of the open run, 0 if none.
+    size_t held_bytes = 0;                            ///< Input bytes written since the last flush.
+    std::chrono::steady_clock::time_point held_since; ///< Arrival time of the oldest held byte.
+};
 
 /**
- * @brief Perform file encoding or decoding action based on action type.
+ * @brief Sum the count bytes of RLE pairs, eight pairs per SSE2 iteration.
  * 
- * @param action_type Action type: 0 for encoding, 1 for decoding.
- * @param parent_window Parent GTK window.
- * @param action GTK file chooser action.
+ * @param in Pointer to the pairs.
+ * @param pairs Number of pairs.
+ * @param has_zero Set to whether any count is zero.
+ * @return Sum of the counts.
  */
-void file_action(int action_type, GtkWidget *parent_window, GtkFileChooserAction action) {
-    GtkWidget *dialog;
-    gint res;
+static uint64_t sum_counts(const unsigned char *in, size_t pairs, bool *has_zero) {
+    uint64_t total = 0;
+    bool zero = false;
+    size_t i = 0;
 
-    dialog = gtk_file_chooser_dialog_new(
-        (action_type == 0) ? "Encode file" : "Save File",
-        GTK_WINDOW(parent_window),
-        action,
-        "_Cancel",
-        GTK_RESPONSE_CANCEL,
-        (action_type == 0) ? "_Encode" : "_Decode",
-        GTK_RESPONSE_ACCEPT,
-        NULL
-    );
+#ifdef __SSE2__
+    const __m128i count_mask = _mm_set1_epi16(0x00ff);
+    const __m128i none = _mm_setzero_si128();
+    __m128i sums = none, zeros = none;
 
-    res = gtk_dialog_run(GTK_DIALOG(dialog));
-    if (res == GTK_RESPONSE_ACCEPT) {
-        char *filename;
-        GtkFileChooser *chooser = GTK_FILE_CHOOSER(dialog);
-        filename = gtk_file_chooser_get_filename(chooser);
+    for (; i + 8 <= pairs; i += 8) {
+        __m128i counts = _mm_and_si128(_mm_loadu_si128(reinterpret_cast<const __m128i *>(in + 2 * i)), count_mask);
+        sums = _mm_add_epi64(sums, _mm_sad_epu8(counts, none));
+        zeros = _mm_or_si128(zeros, _mm_cmpeq_epi16(counts, none));
+    }
 
-        std::ifstream file_in(filename, std::ios::binary | std::ios::ate);
-        std::ofstream file_out;
-        std::vector<unsigned char> data;
-        std::string output_filename;
+    alignas(16) uint64_t lanes[2];
+    _mm_store_si128(reinterpret_cast<__m128i *>(lanes), sums);
+    total = lanes[0] + lanes[1];
+    zero = _mm_movemask_epi8(zeros) != 0;
+#endif
+    for (; i < pairs; ++i) {
+        total += in[2 * i];
+        zero = zero || in[2 * i] == 0;
+    }
 
-        if (file_in.is_open()) {
-            std::streamsize size = file_in.tellg();
-            file_in.seekg(0, std::ios::beg);
-            data.resize(size);
-            file_in.read(reinterpret_cast<char*>(&data[0]), size);
+    *has_zero = zero;
+    return total;
+}
 
-            if (action_type == 0) {
-                std::vector<unsigned char> encoded = encode_rle(data);
-                output_filename = std::string(filename) + ".encoded";
-                file_out.open(output_filename, std::ios::binary);
-                file_out.write(reinterpret_cast<const char*>(&encoded[0]), encoded.size());
-            } else {
-                std::vector<unsigned char> decoded = decode_rle(data);
-                output_filename = std::string(filename) + ".decoded";
-                file_out.open(output_filename, std::ios::binary);
-                file_out.write(reinterpret_cast<const char*>(&decoded[0]), decoded.size());
-            }
+/**
+ * @brief Compute the size of the data an RLE stream decodes to.
+ * 
+ * Only whole pairs are counted. Streams from outside are checked with
+ * rle_validate() first, which rejects a trailing unpaired byte.
+ * 
+ * @param in Pointer to the RLE encoded bytes.
+ * @param size Number of encoded bytes.
+ * @return Number of decoded bytes.
+ */
+size_t rle_decoded_size(const unsigned char *in, size_t size) {
+    bool has_zero;
+    return sum_counts(in, size / 2, &has_zero);
+}
 
-            file_out.close();
-        } else {
-            g_printerr("Failed to open file.\n");
-        }
+/**
+ * @brief Result of validating an RLE stream.
+ */
+enum rle_validation {
+    RLE_VALID,      ///< Well formed and within the size limit.
+    RLE_ODD_LENGTH, ///< Ends with an unpaired byte.
+    RLE_ZERO_COUNT, ///< Contains a pair with a zero count.
+    RLE_TOO_LARGE   ///< Decodes to more than the size limit.
+};
 
-        g_free(filename);
+uint64_t rle_decode_limit = uint64_t(4) << 30; ///< Largest decoded size allocated at once for untrusted input.
+
+static const size_t RLE_VALIDATE_CHUNK = 1 << 15; ///< Pairs summed between size limit checks.
+
+/**
+ * @brief Check an RLE stream before allocating memory for its output.
+ * 
+ * The length is checked first, then counts are summed and checked for
+ * zeros with SSE2 in chunks, stopping as soon as the limit is exceeded.
+ * 
+ * @param in Pointer to the RLE encoded bytes.
+ * @param size Number of encoded bytes.
+ * @param limit Largest decoded size accepted.
+ * @param decoded_size Set to the decoded size if the stream is valid.
+ * @return Validation result.
+ */
+rle_validation rle_validate(const unsigned char *in, size_t size, uint64_t limit, uint64_t *decoded_size) {
+    if (size % 2 != 0) {
+        return RLE_ODD_LENGTH;
     }
 
-    gtk_widget_destroy(dialog);
+    uint64_t total = 0;
+    for (size_t pair = 0; pair < size / 2; pair += RLE_VALIDATE_CHUNK) {
+        bool has_zero;
+        total += sum_counts(in + 2 * pair, std::min(RLE_VALIDATE_CHUNK, size / 2 - pair), &has_zero);
+        if (has_zero) {
+            return RLE_ZERO_COUNT;
+        }
+        if (total > limit) {
+            return RLE_TOO_LARGE;
+        }
+    }
+
+    *decoded_size = total;
+    return RLE_VALID;
 }
 
 /**
- * @brief Callback function for the Encode button click event.
+ * @brief Describe a validation result.
  * 
- * @param button GTK button that was clicked.
- * @param user_data User data passed to the callback function.
+ * @param result Validation result.
+ * @return Human readable message.
  */
-void on_encode_clicked(GtkButton *button, gpointer user_data) {
-    text_action(0, GTK_WIDGET(user_data));
+const char *rle_validation_message(rle_validation result) {
+    switch (result) {
+    case RLE_VALID: return "Valid encoded data.";
+    case RLE_ODD_LENGTH: return "Encoded data has an odd length.";
+    case RLE_ZERO_COUNT: return "Encoded data contains a zero run length.";
+    case RLE_TOO_LARGE: return "Encoded data decodes to more than the size limit.";
+    }
+    return "Invalid encoded data.";
 }
 
+static const size_t RLE_LANES = 4;               ///< Number of interleaved decode lanes.
+static const size_t RLE_LANE_MIN_PAIRS = 1024;   ///< Minimum pairs per lane before splitting.
+
 /**
- * @brief Callback function for the Decode button click event.
+ * @brief Byte ranges of one decode lane within the encoded and decoded data.
+ */
+struct rle_lane_plan {
+    size_t in_begin;  ///< Offset of the lane's first pair in the encoded data.
+    size_t in_end;    ///< End of the lane's pairs in the encoded data.
+    size_t out_begin; ///< Offset of the lane's first byte in the decoded data.
+    size_t out_end;   ///< End of the lane's bytes in the decoded data.
+};
+
+/**
+ * @brief Decode cursor over one lane.
+ */
+struct rle_lane {
+    const unsigned char *in;     ///< Next encoded pair.
+    const unsigned char *in_end; ///< End of the lane's pairs.
+    unsigned char *out;          ///< Next output byte.
+    unsigned char *out_end;      ///< End of the lane's output.
+};
+
+/**
+ * @brief Split an RLE stream into independently decodable lanes.
  * 
- * @param button GTK button that was clicked.
- * @param user_data User data passed to the callback function.
+ * The pairs are divided into RLE_LANES contiguous ranges, and the output
+ * offset of each range is found by summing its counts. Streams shorter than
+ * RLE_LANE_MIN_PAIRS pairs per lane are kept in the first lane.
+ * 
+ * @param in Pointer to the RLE encoded bytes.
+ * @param size Number of encoded bytes.
+ * @param plan Array of RLE_LANES lane ranges to fill.
+ * @return Total number of decoded bytes.
  */
-void on_decode_clicked(GtkButton *button, gpointer user_data) {
-    text_action(1, GTK_WIDGET(user_data));
+size_t rle_plan_lanes(const unsigned char *in, size_t size, rle_lane_plan plan[RLE_LANES]) {
+    size_t pairs = size / 2;
+    size_t lane_pairs = (pairs / RLE_LANES >= RLE_LANE_MIN_PAIRS) ? pairs / RLE_LANES : pairs;
+    size_t in_pos = 0;
+    size_t out_pos = 0;
+
+    for (size_t l = 0; l < RLE_LANES; ++l) {
+        size_t in_end = (l == RLE_LANES - 1) ? size : std::min(size, in_pos + 2 * lane_pairs);
+        if (l == 0 && lane_pairs == pairs) {
+            in_end = size;
+        }
+
+        plan[l].in_begin = in_pos;
+        plan[l].in_end = in_end;
+        plan[l].out_begin = out_pos;
+        out_pos += rle_decoded_size(in + in_pos, in_end - in_pos);
+        plan[l].out_end = out_pos;
+        in_pos = in_end;
+    }
+
+    return out_pos;
 }
 
 /**
- * @brief Callback function for the Encode File button click event.
+ * @brief Portable RLE decode kernel expanding each run with memset.
  * 
- * @param button GTK button that was clicked.
- * @param user_data User data passed to the callback function.
+ * memset already dominates each run here, so the lanes are simply decoded
+ * one after another.
+ * 
+ * @param lanes Array of RLE_LANES lane cursors.
  */
-void on_encode_file_clicked(GtkButton *button, gpointer user_data) {
-    file_action(0, GTK_WIDGET(user_data), GTK_FILE_CHOOSER_ACTION_SAVE);
+static void decode_lanes_scalar(rle_lane *lanes) {
+    for (size_t l = 0; l < RLE_LANES; ++l) {
+        rle_lane &lane = lanes[l];
+
+        for (; lane.in + 1 < lane.in_end; lane.in += 2) {
+            std::memset(lane.out, lane.in[1], lane.in[0]);
+            lane.out += lane.in[0];
+        }
+    }
 }
 
+#ifdef RLE_HAVE_X86
 /**
- * @brief Callback function for the Decode File button click event.
+ * @brief Shuffle mask and output length for four runs of 1-4 bytes each.
+ */
+struct alignas(16) rle_shuffle_entry {
+    unsigned char index[16]; ///< pshufb indices selecting the symbol byte of each pair.
+    unsigned char length;    ///< Number of valid output bytes.
+};
+
+/**
+ * @brief Get the shuffle table for groups of four short runs.
  * 
- * @param button GTK button that was clicked.
- * @param user_data User data passed to the callback function.
+ * The table is indexed by the four run counts minus one, two bits each,
+ * the first run in the lowest bits.
+ * 
+ * @return Pointer to the 256 entry table.
  */
-void on_decode_file_clicked(GtkButton *button, gpointer user_data) {
-    file_action(1, GTK_WIDGET(user_data), GTK_FILE_CHOOSER_ACTION_SAVE);
+static const rle_shuffle_entry *rle_shuffle_table() {
+    static rle_shuffle_entry table[256];
+    static bool initialized = [] {
+        for (unsigned key = 0; key < 256; ++key) {
+            unsigned pos = 0;
+
+            for (unsigned run = 0; run < 4; ++run) {
+                unsigned count = ((key >> (2 * run)) & 3) + 1;
+
+                for (unsigned j = 0; j < count; ++j) {
+                    table[key].index[pos++] = static_cast<unsigned char>(2 * run + 1);
+                }
+            }
+
+            table[key].length = static_cast<unsigned char>(pos);
+            while (pos < 16) {
+                table[key].index[pos++] = 0x80;
+            }
+        }
+        return true;
+    }();
+    (void)initialized;
+    return table;
 }
 
 /**
- * @brief Main function to initialize the GTK application and run the main loop.
+ * @brief Decode one step of a lane with SSSE3.
  * 
- * @param argc Argument count.
- * @param argv Argument vector.
- * @return Exit status code.
+ * A group of four runs that are each 1-4 bytes long is expanded together
+ * with a single pshufb and a 16 byte store. Any other run is written with
+ * 16 byte broadcast stores. Stores may spill past the current run but never
+ * past the lane's out_end; close to the end the step falls back to memset.
+ * 
+ * @param lane Lane cursor with at least one pair left.
+ * @param table Shuffle table from rle_shuffle_table().
  */
-int main(int argc, char *argv[]) {
+__attribute__((target("ssse3")))
+static inline void decode_step_ssse3(rle_lane &lane, const rle_shuffle_entry *table) {
+    const unsigned char *in = lane.in;
+    unsigned char *out = lane.out;
+
+    if (lane.in_end - in >= 8 && lane.out_end - out >= 16) {
+        unsigned k0 = in[0] - 1u, k1 = in[2] - 1u, k2 = in[4] - 1u, k3 = in[6] - 1u;
+
+        if ((k0 | k1 | k2 | k3) < 4) {
+            const rle_shuffle_entry &entry = table[k0 | (k1 << 2) | (k2 << 4) | (k3 << 6)];
+            __m128i pairs = _mm_loadl_epi64(reinterpret_cast<const __m128i *>(in));
+            __m128i mask = _mm_load_si128(reinterpret_cast<const __m128i *>(entry.index));
+            _mm_storeu_si128(reinterpret_cast<__m128i *>(out), _mm_shuffle_epi8(pairs, mask));
+            lane.out = out + entry.length;
+            lane.in = in + 8;
+            return;
+        }
+    }
+
+    size_t count = in[0];
+    size_t padded = (count + 15) & ~static_cast<size_t>(15);
+    if (static_cast<size_t>(lane.out_end - out) >= padded) {
+        __m128i fill = _mm_set1_epi8(static_cast<char>(in[1]));
+        for (size_t j = 0; j < padded; j += 16) {
+            _mm_storeu_si128(reinterpret_cast<__m128i *>(out + j), fill);
+        }
+    } else {
+        std::memset(out, in[1], count);
+    }
+    lane.out = out + count;
+    lane.in = in + 2;
+}
+
+/**
+ * @brief SSSE3 RLE decode kernel.
+ * 
+ * While every lane has pairs left, each loop iteration advances all four
+ * lanes by one step; the remaining pairs are then finished lane by lane.
+ * 
+ * @param lanes Array of RLE_LANES lane cursors.
+ */
+__attribute__((target("ssse3")))
+static void decode_lanes_ssse3(rle_lane *lanes) {
+    const rle_shuffle_entry *table = rle_shuffle_table();
+
+    while (lanes[0].in + 1 < lanes[0].in_end && lanes[1].in + 1 < lanes[1].in_end &&
+           lanes[2].in + 1 < lanes[2].in_end && lanes[3].in + 1 < lanes[3].in_end) {
+        decode_step_ssse3(lanes[0], table);
+        decode_step_ssse3(lanes[1], table);
+        decode_step_ssse3(lanes[2], table);
+        decode_step_ssse3(lanes[3], table);
+    }
+
+    for (size_t l = 0; l < RLE_LANES; ++l) {
+        while (lanes[l].in + 1 < lanes[l].in_end) {
+            decode_step_ssse3(lanes[l], table);
+        }
+    }
+}
+#endif
+
+/**
+ * @brief Decode an RLE stream split by rle_plan_lanes().
+ * 
+ * Uses the SSSE3 shuffle kernel when the CPU supports it.
+ * 
+ * @param in Pointer to the RLE encoded bytes.
+ * @param plan Lane ranges from rle_plan_lanes().
+ * @param out Output buffer, at least as long as the planned decoded size.
+ */
+void decode_rle_planned(const unsigned char *in, const rle_lane_plan plan[RLE_LANES], unsigned char *out) {
+    rle_lane lanes[RLE_LANES];
+
+    for (size_t l = 0; l < RLE_LANES; ++l) {
+        lanes[l].in = in + plan[l].in_begin;
+        lanes[l].in_end = in + plan[l].in_end;
+        lanes[l].out = out + plan[l].out_begin;
+        lanes[l].out_end = out + plan[l].out_end;
+    }
+
+#ifdef RLE_HAVE_X86
+    static const bool has_ssse3 = __builtin_cpu_supports("ssse3");
+    if (has_ssse3) {
+        decode_lanes_ssse3(lanes);
+        return;
+    }
+#endif
+    decode_lanes_scalar(lanes);
+}
+
+/**
+ * @brief Decode an RLE stream into a preallocated buffer.
+ * 
+ * @param in Pointer to the RLE encoded bytes.
+ * @param size Number of encoded bytes.
+ * @param out Output buffer, at least rle_decoded_size() bytes long.
+ * @return Number of decoded bytes.
+ */
+size_t decode_rle_into(const unsigned char *in, size_t size, unsigned char *out) {
+    rle_lane_plan plan[RLE_LANES];
+    size_t total = rle_plan_lanes(in, size, plan);
+    decode_rle_planned(in, plan, out);
+    return total;
+}
+
+/**
+ * @brief Decode data from Run-Length Encoding (RLE).
+ * 
+ * The input is checked with rle_validate() against rle_decode_limit
+ * before any output is allocated.
+ * 
+ * @param encoded RLE encoded vector of bytes.
+ * @return Decoded vector of bytes, empty if the input was rejected.
+ */
+std::vector<unsigned char> decode_rle(const std::vector<unsigned char>& encoded) {
+    uint64_t decoded_size;
+    rle_validation result = rle_validate(encoded.data(), encoded.size(), rle_decode_limit, &decoded_size);
+    if (result != RLE_VALID) {
+        g_printerr("%s\n", rle_validation_message(result));
+        return std::vector<unsigned char>();
+    }
+
+    rle_lane_plan plan[RLE_LANES];
+    std::vector<unsigned char> decoded(rle_plan_lanes(encoded.data(), encoded.size(), plan));
+    decode_rle_planned(encoded.data(), plan, decoded.data());
+    return decoded;
+}
+
+static const size_t RLE_BATCH_MESSAGES = 256; ///< Messages handled per parallel batch.
+
+/**
+ * @brief Read-only view of a byte buffer.
+ */
+struct rle_span {
+    const unsigned char *data; ///< First byte.
+    size_t size;               ///< Number of bytes.
+};
+
+/**
+ * @brief Many messages stored back to back in one buffer.
+ */
+struct rle_batch {
+    std::vector<unsigned char> arena; ///< Concatenated message bytes.
+    std::vector<size_t> offsets;      ///< Start of each message in arena, plus the end of the last one.
+};
+
+/**
+ * @brief Read the CPU limit set on one cgroup directory.
+ * 
+ * @param dir Cgroup directory.
+ * @param v2 Whether the directory is in a cgroup v2 hierarchy.
+ * @return Number of CPUs the quota allows, or 0 if none is set.
+ */
+static double cgroup_dir_cpu_limit(const std::string& dir, bool v2) {
+    double quota = -1, period = 0;
+
+    if (v2) {
+        std::ifstream max(dir + "/cpu.max");
+        std::string quota_text;
+        if (max >> quota_text >> period && quota_text != "max") {
+            quota = std::strtod(quota_text.c_str(), NULL);
+        }
+    } else {
+        std::ifstream v1_quota(dir + "/cpu.cfs_quota_us");
+        std::ifstream v1_period(dir + "/cpu.cfs_period_us");
+        if (!(v1_quota >> quota) || !(v1_period >> period)) {
+            quota = -1;
+        }
+    }
+
+    return (quota > 0 && period > 0) ? quota / period : 0;
+}
+
+/**
+ * @brief Read the CPU limit of the process's cgroup.
+ * 
+ * The process's own cgroup is found in /proc/self/cgroup, and it and each
+ * of its ancestors are checked, since a limit on any of them applies. Both
+ * the cgroup v2 `cpu.max` file and the cgroup v1 CFS quota files are read.
+ * 
+ * @return Number of CPUs the tightest quota allows, rounded up, or 0 if unlimited.
+ */
+unsigned rle_cpu_quota() {
+    struct hierarchy {
+        std::string mount; ///< Mount point of the hierarchy.
+        std::string path;  ///< Cgroup of the process within it.
+        bool v2;           ///< Whether it is a cgroup v2 hierarchy.
+    };
+    std::vector<hierarchy> hierarchies;
+    std::string v1_path = "/", v2_path = "/";
+
+    std::ifstream self("/proc/self/cgroup");
+    std::string line;
+    while (std::getline(self, line)) {
+        size_t first = line.find(':');
+        size_t second = line.find(':', first + 1);
+        if (first == std::string::npos || second == std::string::npos) {
+            continue;
+        }
+        std::string controllers = "," + line.substr(first + 1, second - first - 1) + ",";
+        if (controllers == ",,") {
+            v2_path = line.substr(second + 1);
+        } else if (controllers.find(",cpu,") != std::string::npos) {
+            v1_path = line.substr(second + 1);
+        }
+    }
+    hierarchies.push_back({"/sys/fs/cgroup", v2_path, true});
+    hierarchies.push_back({"/sys/fs/cgroup/cpu", v1_path, false});
+    hierarchies.push_back({"/sys/fs/cgroup/cpu,cpuacct", v1_path, false});
+
+    double limit = 0;
+    for (const hierarchy& h : hierarchies) {
+        for (std::string path = h.path;;) {
+            double level = cgroup_dir_cpu_limit(h.mount + (path == "/" ? "" : path), h.v2);
+            if (level > 0 && (limit == 0 || level < limit)) {
+                limit = level;
+            }
+            size_t slash = path.find_last_of('/');
+            if (path.empty() || path == "/" || slash == std::string::npos) {
+                break;
+            }
+            path = (slash == 0) ? "/" : path.substr(0, slash);
+        }
+    }
+
+    return (limit > 0) ? static_cast<unsigned>(std::ceil(limit)) : 0;
+}
+
+/**
+ * @brief Get the number of worker threads to use for parallel work.
+ * 
+ * This is the number of hardware threads, limited by the cgroup CPU quota.
+ * 
+ * @return Number of threads, at least 1.
+ */
+unsigned rle_worker_count() {
+    static const unsigned count = [] {
+        unsigned hardware = std::thread::hardware_concurrency();
+        unsigned quota = rle_cpu_quota();
+        unsigned threads = hardware ? hardware : 1;
+        if (quota != 0) {
+            threads = std::min(threads, quota);
+        }
+        return threads;
+    }();
+    return count;
+}
+
+/**
+ * @brief Scheduling class of a job.
+ */
+enum rle_job_class {
+    RLE_JOB_INTERACTIVE = 0, ///< Small latency-sensitive job, always run first.
+    RLE_JOB_BULK = 1         ///< One block of a large job.
+};
+
+/**
+ * @brief Latency percentiles of recent jobs of one class.
+ */
+struct rle_latency_stats {
+    size_t jobs;        ///< Jobs completed in total.
+    size_t over_target; ///< Jobs that took longer than the target.
+    double target_ms;   ///< Latency target, 0 if none.
+    double p50_ms;      ///< Median latency of recent jobs.
+    double p99_ms;      ///< 99th percentile latency of recent jobs.
+    double max_ms;      ///< Highest latency of recent jobs.
+};
+
+/**
+ * @brief Worker pool with separate interactive and bulk queues.
+ * 
+ * Workers always take an interactive job before a bulk one. Large jobs are
+ * submitted as one bulk job per block, so an interactive job waits for at
+ * most one block per worker. Threads waiting for their jobs help run
+ * queued jobs. Latency from submission to completion is recorded per class.
+ */
+class rle_scheduler {
+public:
+    /**
+     * @brief Start the workers.
+     * 
+     * @param threads Number of worker threads.
+     */
+    explicit rle_scheduler(unsigned threads) {
+        for (unsigned t = 0; t < threads; ++t) {
+            workers.emplace_back([this] { worker_loop(); });
+        }
+    }
+
+    ~rle_scheduler() {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            stopping = true;
+        }
+        wake.notify_all();
+        for (std::thread &worker : workers) {
+            worker.join();
+        }
+    }
+
+    /**
+     * @brief Queue a job.
+     * 
+     * @param job_class Scheduling class.
+     * @param task Function to run.
+     */
+    void submit(rle_job_class job_class, std::function<void()> task) {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            queues[job_class].push_back({std::move(task), job_class, std::chrono::steady_clock::now()});
+        }
+        wake.notify_one();
+        finished.notify_all();
+    }
+
+    /**
+     * @brief Run a job and wait for it, helping with queued jobs meanwhile.
+     * 
+     * @param job_class Scheduling class.
+     * @param task Function to run.
+     */
+    void run(rle_job_class job_class, const std::function<void()>& task) {
+        std::atomic<size_t> outstanding(1);
+        submit(job_class, [&] {
+            task();
+            --outstanding;
+        });
+        help_until_done(outstanding);
+    }
+
+    /**
+     * @brief Run queued jobs on the calling thread until a counter reaches zero.
+     * 
+     * @param outstanding Counter decremented by the awaited jobs as their last step.
+     */
+    void help_until_done(const std::atomic<size_t>& outstanding) {
+        for (;;) {
+            job next;
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+                finished.wait(lock, [&] {
+                    return outstanding == 0 || !queues[RLE_JOB_INTERACTIVE].empty() || !queues[RLE_JOB_BULK].empty();
+                });
+                if (outstanding == 0) {
+                    return;
+                }
+                pop(next);
+            }
+            execute(next);
+        }
+    }
+
+    /**
+     * @brief Set the latency target reported for a class.
+     * 
+     * @param job_class Scheduling class.
+     * @param target Latency target.
+     */
+    void set_latency_target(rle_job_class job_class, std::chrono::microseconds target) {
+        std::lock_guard<std::mutex> lock(mutex);
+        target_ms[job_class] = target.count() / 1000.0;
+    }
+
+    /**
+     * @brief Get latency statistics for a class.
+     * 
+     * @param job_class Scheduling class.
+     * @return Statistics over the last RLE_LATENCY_SAMPLES jobs.
+     */
+    rle_latency_stats latency(rle_job_class job_class) const {
+        std::vector<double> sorted;
+        rle_latency_stats stats = {};
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            sorted = samples[job_class];
+            stats.jobs = jobs[job_class];
+            stats.over_target = over_target[job_class];
+            stats.target_ms = target_ms[job_class];
+        }
+
+        if (!sorted.empty()) {
+            std::sort(sorted.begin(), sorted.end());
+            stats.p50_ms = sorted[sorted.size() / 2];
+            stats.p99_ms = sorted[std::min(sorted.size() - 1, sorted.size() * 99 / 100)];
+            stats.max_ms = sorted.back();
+        }
+        return stats;
+    }
+
+    /**
+     * @brief Log latency statistics of both classes.
+     */
+    void log_latency() const {
+        static const char *names[] = {"interactive", "bulk"};
+
+        for (int c = RLE_JOB_INTERACTIVE; c <= RLE_JOB_BULK; ++c) {
+            rle_latency_stats stats = latency(static_cast<rle_job_class>(c));
+            if (stats.jobs != 0) {
+                g_message("%s jobs: %zu, p50 %.3f ms, p99 %.3f ms, max %.3f ms, target %.3f ms, %zu over target",
+                          names[c], stats.jobs, stats.p50_ms, stats.p99_ms, stats.max_ms, stats.target_ms, stats.over_target);
+            }
+        }
+    }
+
+private:
+    static const size_t RLE_LATENCY_SAMPLES = 1024; ///< Recent latencies kept per class.
+
+    /**
+     * @brief Queued job.
+     */
+    struct job {
+        std::function<void()> task;                  ///< Function to run.
+        rle_job_class job_class;                     ///< Scheduling class.
+        std::chrono::steady_clock::time_point queued; ///< Submission time.
+    };
+
+    /**
+     * @brief Take the next job, interactive first. The mutex must be held.
+     * 
+     * @param next Job taken.
+     */
+    void pop(job& next) {
+        std::deque<job> &queue = queues[RLE_JOB_INTERACTIVE].empty() ? queues[RLE_JOB_BULK] : queues[RLE_JOB_INTERACTIVE];
+        next = std::move(queue.front());
+        queue.pop_front();
+    }
+
+    /**
+     * @brief Run a job and record its latency.
+     * 
+     * @param current Job to run.
+     */
+    void execute(job& current) {
+        current.task();
+        double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - current.queued).count();
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            int c = current.job_class;
+            if (samples[c].size() < RLE_LATENCY_SAMPLES) {
+                samples[c].push_back(ms);
+            } else {
+                samples[c][jobs[c] % RLE_LATENCY_SAMPLES] = ms;
+            }
+            ++jobs[c];
+            if (target_ms[c] != 0 && ms > target_ms[c]) {
+                ++over_target[c];
+            }
+        }
+        finished.notify_all();
+    }
+
+    /**
+     * @brief Worker thread body.
+     */
+    void worker_loop() {
+        for (;;) {
+            job next;
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+                wake.wait(lock, [this] {
+                    return stopping || !queues[RLE_JOB_INTERACTIVE].empty() || !queues[RLE_JOB_BULK].empty();
+                });
+                if (stopping) {
+                    return;
+                }
+                pop(next);
+            }
+            execute(next);
+        }
+    }
+
+    mutable std::mutex mutex;              ///< Guards the queues and statistics.
+    std::condition_variable wake;          ///< Signals workers that a job was queued.
+    std::condition_variable finished;      ///< Signals waiters that a job was queued or finished.
+    std::deque<job> queues[2];             ///< Queued jobs per class.
+    bool stopping = false;                 ///< Set when the workers should exit.
+    std::vector<std::thread> workers;      ///< Worker threads.
+    std::vector<double> samples[2];        ///< Recent latencies per class, in milliseconds.
+    size_t jobs[2] = {};                   ///< Completed jobs per class.
+    size_t over_target[2] = {};            ///< Jobs over the latency target per class.
+    double target_ms[2] = {};              ///< Latency target per class, 0 if none.
+};
+
+/**
+ * @brief Get the shared scheduler, starting it on first use.
+ * 
+ * It has one worker less than rle_worker_count(), since waiting threads
+ * help run jobs, but always at least one.
+ * 
+ * @return Shared scheduler.
+ */
+rle_scheduler& rle_default_scheduler() {
+    static rle_scheduler scheduler(std::max(1u, rle_worker_count() - 1));
+    return scheduler;
+}
+
+/**
+ * @brief Run a function over the range [0, count) split into bulk jobs.
+ * 
+ * The range is cut into batches of batch_size indices, each run as a
+ * separate bulk job on the shared scheduler so interactive jobs can run
+ * between batches. At most max_threads batches are queued or running at
+ * once; each finished batch queues the next one.
+ * 
+ * @param count Number of indices.
+ * @param batch_size Number of indices handed to a worker at once.
+ * @param body Function called with each [begin, end) batch.
+ * @param max_threads Number of batches to run at once, 0 for rle_worker_count().
+ */
+void parallel_for(size_t count, size_t batch_size, const std::function<void(size_t, size_t)>& body, unsigned max_threads = 0) {
+    size_t batches = (count + batch_size - 1) / batch_size;
+    size_t slots = std::min<size_t>(max_threads ? max_threads : rle_worker_count(), batches);
+    rle_scheduler &scheduler = rle_default_scheduler();
+    std::atomic<size_t> next(0);
+    std::atomic<size_t> outstanding(slots);
+
+    std::function<void()> step = [&] {
+        size_t batch = next++;
+        if (batch < batches) {
+            body(batch * batch_size, std::min(count, (batch + 1) * batch_size));
+        }
+        if (next < batches) {
+            ++outstanding;
+            scheduler.submit(RLE_JOB_BULK, step);
+        }
+        --outstanding;
+    };
+
+    for (size_t s = 0; s < slots; ++s) {
+        scheduler.submit(RLE_JOB_BULK, step);
+    }
+    scheduler.help_until_done(outstanding);
+}
+
+static const size_t RLE_TUNE_MAX_CHUNK = 1 << 26; ///< Largest chunk size the tuner tries.
+
+/**
+ * @brief Online tuner for the chunk size and thread count of a parallel loop.
+ * 
+ * The loop processes windows of threads() chunks of chunk_size() bytes and
+ * reports each window's throughput to record(). The tuner first doubles the
+ * chunk size while throughput improves by more than 5%, then halves the
+ * thread count while throughput stays within 5% of the best seen, and logs
+ * the values it settles on.
+ */
+class rle_tuner {
+public:
+    /**
+     * @brief Create a tuner.
+     * 
+     * @param name Name of the tuned operation, used in the log message.
+     * @param chunk Initial chunk size in bytes.
+     */
+    rle_tuner(const char *name, size_t chunk)
+        : name(name), chunk(chunk), best_chunk(chunk), thread_count(rle_worker_count()), best_threads(thread_count) {
+    }
+
+    /**
+     * @brief Get the chunk size for the next window.
+     */
+    size_t chunk_size() const {
+        return chunk;
+    }
+
+    /**
+     * @brief Get the number of threads for the next window.
+     */
+    unsigned threads() const {
+        return thread_count;
+    }
+
+    /**
+     * @brief Report the throughput of a window and pick the next settings.
+     * 
+     * @param bytes Number of bytes processed.
+     * @param seconds Time taken.
+     */
+    void record(size_t bytes, double seconds) {
+        if (phase == settled || seconds <= 0) {
+            return;
+        }
+        double rate = bytes / seconds;
+
+        if (phase == growing_chunk) {
+            if (rate > best_rate * 1.05) {
+                best_rate = rate;
+                best_chunk = chunk;
+                if (chunk * 2 <= RLE_TUNE_MAX_CHUNK) {
+                    chunk *= 2;
+                    return;
+                }
+            }
+            chunk = best_chunk;
+            phase = trimming_threads;
+        } else if (rate >= best_rate * 0.95) {
+            best_rate = std::max(best_rate, rate);
+            best_threads = thread_count;
+        } else {
+            thread_count = best_threads;
+            settle();
+            return;
+        }
+
+        if (thread_count > 1) {
+            thread_count /= 2;
+        } else {
+            settle();
+        }
+    }
+
+private:
+    /**
+     * @brief Stop tuning and log the chosen values.
+     */
+    void settle() {
+        phase = settled;
+        g_message("%s: chunk size %zu KiB, %u threads (CPU quota %u)", name, chunk >> 10, thread_count, rle_cpu_quota());
+    }
+
+    enum { growing_chunk, trimming_threads, settled } phase = growing_chunk; ///< Tuning phase.
+    const char *name;       ///< Name of the tuned operation.
+    size_t chunk;           ///< Current chunk size.
+    size_t best_chunk;      ///< Chunk size with the best throughput.
+    unsigned thread_count;  ///< Current thread count.
+    unsigned best_threads;  ///< Fewest threads within 5% of the best throughput.
+    double best_rate = 0;   ///< Best throughput seen, in bytes per second.
+};
+
+/**
+ * @brief Get views of the messages stored in a batch.
+ * 
+ * @param batch Batch of messages.
+ * @return One span per message, pointing into the batch's arena.
+ */
+std::vector<rle_span> rle_batch_spans(const rle_batch& batch) {
+    std::vector<rle_span> spans;
+
+    for (size_t i = 0; i + 1 < batch.offsets.size(); ++i) {
+        spans.push_back({batch.arena.data() + batch.offsets[i], batch.offsets[i + 1] - batch.offsets[i]});
+    }
+
+    return spans;
+}
+
+/**
+ * @brief Run a sizing pass and a fill pass over many messages into one arena.
+ * 
+ * @param messages Array of input messages.
+ * @param count Number of messages.
+ * @param size_of Function returning the output size of a message.
+ * @param fill Function writing a message's output to a buffer.
+ * @return Batch holding the outputs of all messages.
+ */
+static rle_batch transform_many(const rle_span *messages, size_t count,
+                                size_t (*size_of)(const unsigned char *, size_t),
+                                size_t (*fill)(const unsigned char *, size_t, unsigned char *)) {
+    rle_batch batch;
+    batch.offsets.resize(count + 1);
+
+    parallel_for(count, RLE_BATCH_MESSAGES, [&](size_t begin, size_t end) {
+        for (size_t i = begin; i < end; ++i) {
+            batch.offsets[i + 1] = size_of(messages[i].data, messages[i].size);
+        }
+    });
+
+    batch.offsets[0] = 0;
+    for (size_t i = 0; i < count; ++i) {
+        batch.offsets[i + 1] += batch.offsets[i];
+    }
+    batch.arena.resize(batch.offsets[count]);
+
+    parallel_for(count, RLE_BATCH_MESSAGES, [&](size_t begin, size_t end) {
+        for (size_t i = begin; i < end; ++i) {
+            fill(messages[i].data, messages[i].size, batch.arena.data() + batch.offsets[i]);
+        }
+    });
+
+    return batch;
+}
+
+/**
+ * @brief Encode many messages with RLE into one arena.
+ * 
+ * Output sizes are computed first so the arena is allocated once, then
+ * batches of messages are encoded in parallel.
+ * 
+ * @param messages Array of input messages.
+ * @param count Number of messages.
+ * @return Batch of encoded messages, in input order.
+ */
+rle_batch encode_many(const rle_span *messages, size_t count) {
+    return transform_many(messages, count, rle_encoded_size, encode_rle_into);
+}
+
+/**
+ * @brief Decode many RLE encoded messages into one arena.
+ * 
+ * All messages are validated in parallel first; the total decoded size
+ * must stay within rle_decode_limit.
+ * 
+ * @param messages Array of encoded messages.
+ * @param count Number of messages.
+ * @return Batch of decoded messages, in input order, empty if any message was rejected.
+ */
+rle_batch decode_many(const rle_span *messages, size_t count) {
+    std::atomic<int> failure(RLE_VALID);
+    std::atomic<uint64_t> total(0);
+
+    parallel_for(count, RLE_BATCH_MESSAGES, [&](size_t begin, size_t end) {
+        uint64_t batch_total = 0;
+        for (size_t i = begin; i < end && failure == RLE_VALID; ++i) {
+            uint64_t decoded_size = 0;
+            rle_validation result = rle_validate(messages[i].data, messages[i].size, rle_decode_limit, &decoded_size);
+            if (result != RLE_VALID) {
+                failure = result;
+            }
+            batch_total += decoded_size;
+        }
+        if ((total += batch_total) > rle_decode_limit) {
+            failure = RLE_TOO_LARGE;
+        }
+    });
+
+    if (failure != RLE_VALID) {
+        g_printerr("%s\n", rle_validation_message(static_cast<rle_validation>(failure.load())));
+        return rle_batch();
+    }
+    return transform_many(messages, count, rle_decoded_size, decode_rle_into);
+}
+
+/**
+ * @brief Sequential writer over an array of output buffers.
+ */
+struct rle_iov_writer {
+    const struct iovec *iov; ///< Output buffers.
+    int count;               ///< Number of output buffers.
+    int index = 0;           ///< Buffer being written.
+    size_t offset = 0;       ///< Write position in that buffer.
+    size_t written = 0;      ///< Total bytes written.
+    bool overflow = false;   ///< Set when the output buffers ran out.
+
+    rle_iov_writer(const struct iovec *iov, int count) : iov(iov), count(count) {
+    }
+
+    /**
+     * @brief Get the buffer being written, skipping full ones.
+     * 
+     * @return Remaining bytes in that buffer, 0 if none are left.
+     */
+    size_t room() {
+        while (index < count && offset == iov[index].iov_len) {
+            ++index;
+            offset = 0;
+        }
+        return index < count ? iov[index].iov_len - offset : 0;
+    }
+
+    /**
+     * @brief Write a byte repeated a number of times.
+     * 
+     * @param byte Byte to write.
+     * @param repeat Number of copies.
+     */
+    void fill(unsigned char byte, size_t repeat) {
+        while (repeat > 0) {
+            size_t n = std::min(repeat, room());
+            if (n == 0) {
+                overflow = true;
+                return;
+            }
+            std::memset(static_cast<unsigned char *>(iov[index].iov_base) + offset, byte, n);
+            offset += n;
+            written += n;
+            repeat -= n;
+        }
+    }
+
+    /**
+     * @brief Write one RLE pair.
+     * 
+     * @param run Run length.
+     * @param byte Run byte.
+     */
+    void pair(size_t run, unsigned char byte) {
+        if (room() >= 2) {
+            unsigned char *out = static_cast<unsigned char *>(iov[index].iov_base) + offset;
+            out[0] = static_cast<unsigned char>(run);
+            out[1] = byte;
+            offset += 2;
+            written += 2;
+        } else {
+            fill(static_cast<unsigned char>(run), 1);
+            fill(byte, 1);
+        }
+    }
+};
+
+/**
+ * @brief Encode data scattered over several buffers into several buffers.
+ * 
+ * Runs continue across input fragment boundaries, so the output is the
+ * same as encoding the concatenated input, and pairs may be split across
+ * output buffers.
+ * 
+ * @param in Input buffers.
+ * @param in_count Number of input buffers.
+ * @param out Output buffers, filled in order.
+ * @param out_count Number of output buffers.
+ * @return Number of encoded bytes, or -1 if the output buffers are too small.
+ */
+ssize_t encode_rle_iov(const struct iovec *in, int in_count, const struct iovec *out, int out_count) {
+    rle_iov_writer writer(out, out_count);
+    unsigned char run_byte = 0;
+    size_t run_count = 0;
+
+    for (int f = 0; f < in_count; ++f) {
+        const unsigned char *data = static_cast<const unsigned char *>(in[f].iov_base);
+        size_t size = in[f].iov_len;
+
+        for (size_t i = 0; i < size;) {
+            if (run_count == RLE_MAX_RUN || (run_count > 0 && data[i] != run_byte)) {
+                writer.pair(run_count, run_byte);
+                run_count = 0;
+            }
+            if (run_count == 0) {
+                run_byte = data[i];
+            }
+            while (i < size && run_count < RLE_MAX_RUN && data[i] == run_byte) {
+                ++run_count;
+                ++i;
+            }
+        }
+    }
+    if (run_count > 0) {
+        writer.pair(run_count, run_byte);
+    }
+
+    return writer.overflow ? -1 : static_cast<ssize_t>(writer.written);
+}
+
+/**
+ * @brief Decode RLE data scattered over several buffers into several buffers.
+ * 
+ * A pair may be split across input fragments. A trailing unpaired byte is
+ * rejected, as in decode_rle().
+ * 
+ * @param in Input buffers.
+ * @param in_count Number of input buffers.
+ * @param out Output buffers, filled in order.
+ * @param out_count Number of output buffers.
+ * @return Number of decoded bytes, or -1 if the output buffers are too small
+ *         or the input ends with an unpaired byte.
+ */
+ssize_t decode_rle_iov(const struct iovec *in, int in_count, const struct iovec *out, int out_count) {
+    rle_iov_writer writer(out, out_count);
+    bool have_count = false;
+    unsigned char count = 0;
+
+    for (int f = 0; f < in_count && !writer.overflow; ++f) {
+        const unsigned char *data = static_cast<const unsigned char *>(in[f].iov_base);
+        size_t size = in[f].iov_len;
+        size_t i = 0;
+
+        if (have_count && size > 0) {
+            writer.fill(data[0], count);
+            have_count = false;
+            i = 1;
+        }
+        for (; i + 1 < size; i += 2) {
+            writer.fill(data[i + 1], data[i]);
+        }
+        if (i < size) {
+            count = data[i];
+            have_count = true;
+        }
+    }
+
+    return (writer.overflow || have_count) ? -1 : static_cast<ssize_t>(writer.written);
+}
+
+/**
+ * @brief Token bucket rate limiter shared between threads.
+ * 
+ * Callers may take more tokens than the bucket holds; the bucket then goes
+ * into debt and later callers wait until it is paid back, so the long-term
+ * rate never exceeds the limit.
+ */
+class rle_token_bucket {
+public:
+    /**
+     * @brief Set the rate limit.
+     * 
+     * The bucket holds up to a tenth of a second of tokens, and at least one.
+     * 
+     * @param per_second Tokens per second, 0 for no limit.
+     */
+    void set_rate(double per_second) {
+        std::lock_guard<std::mutex> lock(mutex);
+        rate = per_second;
+        burst = std::max(per_second / 10, 1.0);
+        tokens = burst;
+        last = std::chrono::steady_clock::now();
+    }
+
+    /**
+     * @brief Take tokens, sleeping until the rate limit allows it.
+     * 
+     * @param amount Number of tokens.
+     */
+    void acquire(double amount) {
+        std::chrono::steady_clock::time_point ready;
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            if (rate <= 0) {
+                return;
+            }
+            auto now = std::chrono::steady_clock::now();
+            tokens = std::min(burst, tokens + std::chrono::duration<double>(now - last).count() * rate);
+            last = now;
+            tokens -= amount;
+            if (tokens >= 0) {
+                return;
+            }
+            ready = now + std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+                std::chrono::duration<double>(-tokens / rate));
+        }
+        std::this_thread::sleep_until(ready);
+    }
+
+private:
+    std::mutex mutex;                          ///< Guards the fields below.
+    double rate = 0;                           ///< Tokens per second, 0 for no limit.
+    double burst = 0;                          ///< Most tokens the bucket holds.
+    double tokens = 0;                         ///< Tokens available, negative when in debt.
+    std::chrono::steady_clock::time_point last; ///< Time of the last refill.
+};
+
+/**
+ * @brief Limits applied to file I/O, zero meaning unlimited.
+ */
+struct rle_io_limits {
+    double read_bytes_per_second = 0;  ///< Read bandwidth.
+    double write_bytes_per_second = 0; ///< Write bandwidth.
+    double reads_per_second = 0;       ///< Read operations.
+    double writes_per_second = 0;      ///< Write operations.
+    bool idle_priority = false;        ///< Use the idle I/O scheduling class.
+};
+
+/**
+ * @brief Bandwidth and IOPS limiter for file reads and writes.
+ */
+class rle_io_throttle {
+public:
+    /**
+     * @brief Apply new limits.
+     * 
+     * @param limits Limits to apply.
+     */
+    void configure(const rle_io_limits& limits) {
+        current = limits;
+        read_bytes.set_rate(limits.read_bytes_per_second);
+        write_bytes.set_rate(limits.write_bytes_per_second);
+        read_ops.set_rate(limits.reads_per_second);
+        write_ops.set_rate(limits.writes_per_second);
+
+        if (limits.idle_priority) {
+#if defined(__linux__) && defined(SYS_ioprio_set)
+            const int who_process = 1, class_idle = 3, class_shift = 13;
+            if (syscall(SYS_ioprio_set, who_process, 0, class_idle << class_shift) != 0) {
+                g_printerr("Failed to set idle I/O priority.\n");
+            }
+#else
+            g_printerr("Idle I/O priority is not supported on this platform.\n");
+#endif
+        }
+    }
+
+    /**
+     * @brief Get the limits last applied by configure().
+     */
+    const rle_io_limits& limits() const {
+        return current;
+    }
+
+    /**
+     * @brief Wait until a read of the given size is allowed.
+     * 
+     * @param bytes Number of bytes about to be read.
+     */
+    void before_read(size_t bytes) {
+        read_ops.acquire(1);
+        read_bytes.acquire(bytes);
+    }
+
+    /**
+     * @brief Wait until a write of the given size is allowed.
+     * 
+     * @param bytes Number of bytes about to be written.
+     */
+    void before_write(size_t bytes) {
+        write_ops.acquire(1);
+        write_bytes.acquire(bytes);
+    }
+
+private:
+    rle_token_bucket read_bytes;  ///< Read bandwidth limit.
+    rle_token_bucket write_bytes; ///< Write bandwidth limit.
+    rle_token_bucket read_ops;    ///< Read IOPS limit.
+    rle_token_bucket write_ops;   ///< Write IOPS limit.
+    rle_io_limits current;        ///< Limits last applied.
+};
+
+rle_io_throttle io_throttle; ///< Limiter applied to all file I/O.
+
+/**
+ * @brief Read from a stream within the configured I/O limits.
+ * 
+ * @param in Stream to read from.
+ * @param data Output buffer.
+ * @param size Number of bytes to read.
+ * @return Number of bytes read.
+ */
+size_t throttled_read(std::istream& in, unsigned char *data, size_t size) {
+    io_throttle.before_read(size);
+    in.read(reinterpret_cast<char*>(data), size);
+    return in.gcount();
+}
+
+/**
+ * @brief Write to a stream within the configured I/O limits.
+ * 
+ * @param out Stream to write to.
+ * @param data Bytes to write.
+ * @param size Number of bytes.
+ */
+void throttled_write(std::ostream& out, const void *data, size_t size) {
+    io_throttle.before_write(size);
+    out.write(static_cast<const char*>(data), size);
+}
+
+/**
+ * @brief Consumer of the chunks read by rle_pipeline_run().
+ */
+class rle_sink {
+public:
+    virtual ~rle_sink() {
+    }
+
+    /**
+     * @brief Process the next chunk of input.
+     * 
+     * @param data Pointer to the chunk.
+     * @param size Number of bytes.
+     */
+    virtual void consume(const unsigned char *data, size_t size) = 0;
+
+    /**
+     * @brief Called once after the last chunk.
+     */
+    virtual void finish() {
+    }
+};
+
+/**
+ * @brief Sink writing the RLE encoding of the input to a stream.
+ */
+class rle_encode_sink : public rle_sink {
+public:
+    /**
+     * @brief Create an encoding sink.
+     * 
+     * @param out Stream receiving the encoded bytes.
+     */
+    explicit rle_encode_sink(std::ostream& out)
+        : encoder([&out](const unsigned char *bytes, size_t count) {
+              throttled_write(out, bytes, count);
+          }) {
+    }
+
+    void consume(const unsigned char *data, size_t size) override {
+        encoder.write(data, size);
+        decoded_bytes += size;
+    }
+
+    void finish() override {
+        encoder.flush();
+    }
+
+    uint64_t decoded_bytes = 0; ///< Input bytes consumed, the decoded size of the output.
+
+private:
+    rle_stream_encoder encoder; ///< Encoder holding runs across chunks.
+};
+
+/**
+ * @brief Sink computing the SHA-256 checksum of the input.
+ */
+class rle_hash_sink : public rle_sink {
+public:
+    rle_hash_sink() : checksum(g_checksum_new(G_CHECKSUM_SHA256)) {
+    }
+
+    ~rle_hash_sink() override {
+        g_checksum_free(checksum);
+    }
+
+    rle_hash_sink(const rle_hash_sink&) = delete;
+    rle_hash_sink& operator=(const rle_hash_sink&) = delete;
+
+    void consume(const unsigned char *data, size_t size) override {
+        g_checksum_update(checksum, data, size);
+    }
+
+    void finish() override {
+        digest = g_checksum_get_string(checksum);
+    }
+
+    std::string digest; ///< Hex digest, set by finish().
+
+private:
+    GChecksum *checksum; ///< Running checksum.
+};
+
+/**
+ * @brief Sink collecting a histogram of run lengths.
+ * 
+ * Runs continue across chunks and are not capped at RLE_MAX_RUN. Bucket i
+ * counts runs of length [2^i, 2^(i+1)).
+ */
+class rle_histogram_sink : public rle_sink {
+public:
+    void consume(const unsigned char *data, size_t size) override {
+        for (size_t i = 0; i < size;) {
+            if (run_length > 0 && data[i] != run_byte) {
+                close_run();
+            }
+            run_byte = data[i];
+            size_t end = i;
+            while (end < size && data[end] == run_byte) {
+                ++end;
+            }
+            run_length += end - i;
+            i = end;
+        }
+    }
+
+    void finish() override {
+        close_run();
+    }
+
+    uint64_t buckets[64] = {}; ///< Run counts by power-of-two length bucket.
+    uint64_t runs = 0;         ///< Total number of runs.
+
+private:
+    void close_run() {
+        if (run_length > 0) {
+            ++buckets[63 - __builtin_clzll(run_length)];
+            ++runs;
+            run_length = 0;
+        }
+    }
+
+    unsigned char run_byte = 0; ///< Byte of the open run.
+    uint64_t run_length = 0;    ///< Length of the open run.
+};
+
+/**
+ * @brief Sink writing the input as hex to a stream.
+ */
+class rle_hex_sink : public rle_sink {
+public:
+    /**
+     * @brief Create a hex sink.
+     * 
+     * @param out Stream receiving the hex digits.
+     */
+    explicit rle_hex_sink(std::ostream& out) : out(out) {
+    }
+
+    void consume(const unsigned char *data, size_t size) override {
+        hex.resize(2 * size);
+        bytes_to_hex_into(data, size, &hex[0]);
+        throttled_write(out, hex.data(), hex.size());
+    }
+
+private:
+    std::ostream &out; ///< Output stream.
+    std::string hex;   ///< Hex of the current chunk.
+};
+
+static const size_t RLE_PIPELINE_CHUNK = 1 << 18; ///< Bytes per pipeline chunk, sized to stay in cache.
+
+/**
+ * @brief Read a file once and pass each chunk to every sink in turn.
+ * 
+ * Chunks are small enough to still be in cache when the later sinks see
+ * them, so several results cost a single pass over memory.
+ * 
+ * @param path Input file.
+ * @param sinks Sinks, called in order for each chunk.
+ * @return True on success.
+ */
+bool rle_pipeline_run(const std::string& path, const std::vector<rle_sink*>& sinks) {
+    std::ifstream file_in(path, std::ios::binary);
+    if (!file_in.is_open()) {
+        g_printerr("Failed to open file.\n");
+        return false;
+    }
+
+    std::vector<unsigned char> chunk(RLE_PIPELINE_CHUNK);
+    while (size_t count = throttled_read(file_in, chunk.data(), chunk.size())) {
+        for (rle_sink *sink : sinks) {
+            sink->consume(chunk.data(), count);
+        }
+    }
+    for (rle_sink *sink : sinks) {
+        sink->finish();
+    }
+
+    return !file_in.bad();
+}
+
+/**
+ * @brief Read-only memory mapping of a whole file.
+ */
+class rle_mapped_file {
+public:
+    /**
+     * @brief Map a file.
+     * 
+     * @param path Path of the file.
+     */
+    explicit rle_mapped_file(const std::string& path) {
+        int fd = open(path.c_str(), O_RDONLY);
+        if (fd < 0) {
+            return;
+        }
+
+        struct stat info;
+        if (fstat(fd, &info) == 0) {
+            size = info.st_size;
+            valid = true;
+            if (size != 0) {
+                void *mapping = mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+                if (mapping == MAP_FAILED) {
+                    valid = false;
+                } else {
+                    data = static_cast<const unsigned char *>(mapping);
+                    madvise(mapping, size, MADV_SEQUENTIAL);
+                }
+            }
+        }
+        close(fd);
+    }
+
+    ~rle_mapped_file() {
+        if (data != NULL) {
+            munmap(const_cast<unsigned char *>(data), size);
+        }
+    }
+
+    rle_mapped_file(const rle_mapped_file&) = delete;
+    rle_mapped_file& operator=(const rle_mapped_file&) = delete;
+
+    /**
+     * @brief Drop the resident pages before an offset once they have been consumed.
+     * 
+     * Pages are dropped in whole 2 MiB granules, so a large page cache folio
+     * never straddles the boundary and gets mapped again in full by a later
+     * fault. The pages are read from the file again if accessed later.
+     * 
+     * @param offset Offset up to which the mapping has been consumed; must not decrease.
+     */
+    void release_before(size_t offset) {
+        static const size_t granule = 2 << 20;
+        size_t end = std::min(offset, size) / granule * granule;
+        if (data != NULL && end > released) {
+            madvise(const_cast<unsigned char *>(data) + released, end - released, MADV_DONTNEED);
+            released = end;
+        }
+    }
+
+    const unsigned char *data = NULL; ///< Mapped bytes, NULL for empty files.
+    size_t size = 0;                  ///< File size in bytes.
+    bool valid = false;               ///< Whether the file was opened and mapped.
+
+private:
+    size_t released = 0; ///< Offset below which release_before() dropped the pages.
+};
+
+/**
+ * @brief Contents of the ".meta" sidecar written next to an encoded file.
+ * 
+ * The encoded size and modification time identify the encoded file the
+ * record describes, so a sidecar left behind by an overwritten file is
+ * detected as stale. Fields are in host byte order.
+ */
+struct rle_index_record {
+    char magic[8];          ///< RLE_INDEX_MAGIC.
+    uint64_t encoded_size;  ///< Size of the encoded file.
+    int64_t encoded_mtime;  ///< Modification time of the encoded file in nanoseconds.
+    uint64_t decoded_size;  ///< Size of the decoded data.
+};
+
+static const char RLE_INDEX_MAGIC[8] = {'R', 'L', 'E', 'M', 'E', 'T', 'A', '1'}; ///< Sidecar magic.
+
+/**
+ * @brief Get the path of the sidecar describing an encoded file.
+ */
+std::string rle_index_path(const std::string& encoded_path) {
+    return encoded_path + ".meta";
+}
+
+/**
+ * @brief Get a file's modification time in nanoseconds.
+ */
+static int64_t file_mtime_ns(const struct stat& info) {
+    return static_cast<int64_t>(info.st_mtim.tv_sec) * 1000000000 + info.st_mtim.tv_nsec;
+}
+
+/**
+ * @brief Write the sidecar of a finished encoded file.
+ * 
+ * Must be called after the encoded file is closed.
+ * 
+ * @param encoded_path Encoded file.
+ * @param decoded_size Number of bytes that were encoded.
+ * @return True if the sidecar was written.
+ */
+bool rle_write_index(const std::string& encoded_path, uint64_t decoded_size) {
+    struct stat info;
+    if (stat(encoded_path.c_str(), &info) != 0) {
+        return false;
+    }
+
+    rle_index_record record;
+    std::memcpy(record.magic, RLE_INDEX_MAGIC, sizeof(record.magic));
+    record.encoded_size = info.st_size;
+    record.encoded_mtime = file_mtime_ns(info);
+    record.decoded_size = decoded_size;
+
+    std::ofstream file_out(rle_index_path(encoded_path), std::ios::binary | std::ios::trunc);
+    file_out.write(reinterpret_cast<const char*>(&record), sizeof(record));
+    return file_out.good();
+}
+
+/**
+ * @brief Where rle_lookup_decoded_size() found a decoded size.
+ */
+enum rle_index_source {
+    RLE_INDEX_SIDECAR, ///< Read from an up to date sidecar.
+    RLE_INDEX_SCANNED, ///< Computed by validating the encoded file.
+    RLE_INDEX_INVALID  ///< The file could not be read or is not valid RLE.
+};
+
+/**
+ * @brief Read the decoded size of an encoded file from its sidecar only.
+ * 
+ * @param encoded_path Encoded file.
+ * @param encoded_size Size of the encoded file, set if the file exists.
+ * @param decoded_size Decoded size, set if the sidecar matches the encoded file.
+ * @return True if an up to date sidecar was found.
+ */
+bool rle_read_index(const std::string& encoded_path, uint64_t& encoded_size, uint64_t& decoded_size) {
+    struct stat info;
+    if (stat(encoded_path.c_str(), &info) != 0) {
+        return false;
+    }
+    encoded_size = info.st_size;
+
+    rle_index_record record;
+    std::ifstream index_in(rle_index_path(encoded_path), std::ios::binary);
+    if (index_in.read(reinterpret_cast<char*>(&record), sizeof(record)) &&
+        std::memcmp(record.magic, RLE_INDEX_MAGIC, sizeof(record.magic)) == 0 &&
+        record.encoded_size == encoded_size && record.encoded_mtime == file_mtime_ns(info)) {
+        decoded_size = record.decoded_size;
+        return true;
+    }
+    return false;
+}
+
+/**
+ * @brief Get the decoded size of an encoded file without decoding it.
+ * 
+ * Only the sidecar is read when it matches the encoded file; otherwise
+ * the file is mapped and checked with rle_validate().
+ * 
+ * @param encoded_path Encoded file.
+ * @param encoded_size Size of the encoded file.
+ * @param decoded_size Decoded size, set unless the result is RLE_INDEX_INVALID.
+ * @return Where the size came from.
+ */
+rle_index_source rle_lookup_decoded_size(const std::string& encoded_path, uint64_t& encoded_size, uint64_t& decoded_size) {
+    if (rle_read_index(encoded_path, encoded_size, decoded_size)) {
+        return RLE_INDEX_SIDECAR;
+    }
+
+    rle_mapped_file file(encoded_path);
+    if (!file.valid || rle_validate(file.data, file.size, UINT64_MAX, &decoded_size) != RLE_VALID) {
+        return RLE_INDEX_INVALID;
+    }
+    return RLE_INDEX_SCANNED;
+}
+
+static const size_t RLE_DELTA_BLOCK = 1 << 20; ///< Initial bytes per block in delta encoding.
+
+/**
+ * @brief XOR a buffer with the bytes of a base file at the same offset.
+ * 
+ * Bytes past the end of the base are left unchanged.
+ * 
+ * @param data Buffer to modify.
+ * @param size Number of bytes.
+ * @param base Base file.
+ * @param offset Offset of the buffer within the whole data.
+ */
+void xor_with_base(unsigned char *data, size_t size, const rle_mapped_file& base, size_t offset) {
+    if (offset >= base.size) {
+        return;
+    }
+    size_t count = std::min(size, base.size - offset);
+    const unsigned char *reference = base.data + offset;
+
+    for (size_t i = 0; i < count; ++i) {
+        data[i] ^= reference[i];
+    }
+}
+
+/**
+ * @brief Encode a file as the RLE of its XOR with a base file.
+ * 
+ * Regions equal to the base become runs of zeros. The input is processed
+ * in windows of one block per worker thread, with block size and thread
+ * count chosen by an rle_tuner. Blocks in a window are encoded in parallel
+ * and written in order, so memory use does not grow with the file size.
+ * 
+ * @param input_path File to encode.
+ * @param base_path Base file.
+ * @param output_path Encoded output file.
+ * @return True on success.
+ */
+bool encode_rle_delta_file(const std::string& input_path, const std::string& base_path, const std::string& output_path) {
+    rle_mapped_file input(input_path);
+    rle_mapped_file base(base_path);
+    std::ofstream file_out(output_path, std::ios::binary);
+    if (!input.valid || !base.valid || !file_out.is_open()) {
+        g_printerr("Failed to open file.\n");
+        return false;
+    }
+
+    rle_tuner tuner("delta encode", RLE_DELTA_BLOCK);
+    std::vector<std::vector<unsigned char>> scratch, encoded;
+
+    for (size_t window = 0; window < input.size;) {
+        auto start = std::chrono::steady_clock::now();
+        size_t block_size = tuner.chunk_size();
+        size_t blocks = std::min<size_t>(tuner.threads(), (input.size - window + block_size - 1) / block_size);
+        io_throttle.before_read(std::min(input.size - window, blocks * block_size));
+        scratch.resize(std::max(scratch.size(), blocks));
+        encoded.resize(std::max(encoded.size(), blocks));
+
+        parallel_for(blocks, 1, [&](size_t begin, size_t end) {
+            for (size_t b = begin; b < end; ++b) {
+                size_t offset = window + b * block_size;
+                size_t size = std::min(block_size, input.size - offset);
+                scratch[b].assign(input.data + offset, input.data + offset + size);
+                xor_with_base(scratch[b].data(), size, base, offset);
+                encoded[b].resize(rle_encoded_size(scratch[b].data(), size));
+                encode_rle_into(scratch[b].data(), size, encoded[b].data());
+            }
+        }, tuner.threads());
+
+        for (size_t b = 0; b < blocks; ++b) {
+            throttled_write(file_out, encoded[b].data(), encoded[b].size());
+        }
+
+        size_t done = std::min(input.size - window, blocks * block_size);
+        window += done;
+        tuner.record(done, std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count());
+    }
+
+    return file_out.good();
+}
+
+/**
+ * @brief Decode a file encoded by encode_rle_delta_file().
+ * 
+ * The encoded input is cut into blocks whose size is chosen by an
+ * rle_tuner. For each window, blocks are validated in parallel to find their output
+ * offsets, then the blocks are decoded and XORed with the base in parallel.
+ * rle_decode_limit applies to each block, since every block is its own
+ * allocation and only one window is held at a time; the whole output may
+ * be larger.
+ * 
+ * @param input_path Encoded file.
+ * @param base_path Base file used for encoding.
+ * @param output_path Decoded output file.
+ * @return True on success.
+ */
+bool decode_rle_delta_file(const std::string& input_path, const std::string& base_path, const std::string& output_path) {
+    rle_mapped_file input(input_path);
+    rle_mapped_file base(base_path);
+    std::ofstream file_out(output_path, std::ios::binary);
+    if (!input.valid || !base.valid || !file_out.is_open()) {
+        g_printerr("Failed to open file.\n");
+        return false;
+    }
+
+    rle_tuner tuner("delta decode", RLE_DELTA_BLOCK);
+    std::vector<std::vector<unsigned char>> decoded;
+    std::vector<size_t> offsets;
+    size_t output_offset = 0;
+
+    for (size_t window = 0; window < input.size;) {
+        auto start = std::chrono::steady_clock::now();
+        size_t block_size = tuner.chunk_size();
+        size_t blocks = std::min<size_t>(tuner.threads(), (input.size - window + block_size - 1) / block_size);
+        io_throttle.before_read(std::min(input.size - window, blocks * block_size));
+        decoded.resize(std::max(decoded.size(), blocks));
+        offsets.resize(blocks + 1);
+
+        std::atomic<int> failure(RLE_VALID);
+        parallel_for(blocks, 1, [&](size_t begin, size_t end) {
+            for (size_t b = begin; b < end; ++b) {
+                size_t offset = window + b * block_size;
+                uint64_t decoded_size = 0;
+                rle_validation result = rle_validate(input.data + offset, std::min(block_size, input.size - offset),
+                                                     rle_decode_limit, &decoded_size);
+                if (result != RLE_VALID) {
+                    failure = result;
+                }
+                offsets[b + 1] = decoded_size;
+            }
+        }, tuner.threads());
+        offsets[0] = output_offset;
+        for (size_t b = 0; b < blocks; ++b) {
+            offsets[b + 1] += offsets[b];
+        }
+        if (failure != RLE_VALID) {
+            g_printerr("%s\n", rle_validation_message(static_cast<rle_validation>(failure.load())));
+            return false;
+        }
+
+        parallel_for(blocks, 1, [&](size_t begin, size_t end) {
+            for (size_t b = begin; b < end; ++b) {
+                size_t offset = window + b * block_size;
+                decoded[b].resize(offsets[b + 1] - offsets[b]);
+                decode_rle_into(input.data + offset, std::min(block_size, input.size - offset), decoded[b].data());
+                xor_with_base(decoded[b].data(), decoded[b].size(), base, offsets[b]);
+            }
+        }, tuner.threads());
+
+        for (size_t b = 0; b < blocks; ++b) {
+            throttled_write(file_out, decoded[b].data(), decoded[b].size());
+        }
+        output_offset = offsets[blocks];
+
+        size_t done = std::min(input.size - window, blocks * block_size);
+        window += done;
+        tuner.record(done, std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count());
+    }
+
+    return file_out.good();
+}
+
+/**
+ * @brief Encode a byte range of a file, passing the pairs to a sink.
+ * 
+ * @param fd Input file descriptor.
+ * @param begin Offset of the first byte.
+ * @param end Offset past the last byte.
+ * @param sink Receives the encoded pairs in order.
+ * @return True if the whole range was read.
+ */
+bool encode_file_range(int fd, uint64_t begin, uint64_t end, const std::function<void(const unsigned char *, size_t)>& sink) {
+    rle_stream_encoder encoder(sink);
+    std::vector<unsigned char> chunk(RLE_PIPELINE_CHUNK);
+
+    for (uint64_t offset = begin; offset < end;) {
+        size_t wanted = std::min<uint64_t>(chunk.size(), end - offset);
+        io_throttle.before_read(wanted);
+        ssize_t count = pread(fd, chunk.data(), wanted, offset);
+        if (count <= 0) {
+            return false;
+        }
+        encoder.write(chunk.data(), count);
+        offset += count;
+    }
+    encoder.flush();
+    return true;
+}
+
+/**
+ * @brief Encode a byte range of a file into a known place in the output file.
+ * 
+ * @param fd Input file descriptor.
+ * @param begin Offset of the first byte.
+ * @param end Offset past the last byte.
+ * @param out_fd Output file descriptor.
+ * @param out_offset Output offset of the first pair.
+ * @param expected Encoded size found by the size pass.
+ * @return True if the range was written and had the expected size.
+ */
+bool encode_file_range_at(int fd, uint64_t begin, uint64_t end, int out_fd, uint64_t out_offset, uint64_t expected) {
+    uint64_t written = 0;
+    bool ok = true;
+    bool read = encode_file_range(fd, begin, end, [&](const unsigned char *bytes, size_t count) {
+        if (!ok || written + count > expected) {
+            ok = false;
+            return;
+        }
+        io_throttle.before_write(count);
+        while (count > 0) {
+            ssize_t done = pwrite(out_fd, bytes, count, out_offset + written);
+            if (done <= 0) {
+                ok = false;
+                return;
+            }
+            bytes += done;
+            count -= done;
+            written += done;
+        }
+    });
+    return read && ok && written == expected;
+}
+
+/**
+ * @brief Encode one file with several worker processes.
+ * 
+ * The input is split into equal byte ranges. A first pass encodes every
+ * range on the scheduler without keeping the pairs, only to learn the
+ * encoded size of each range. The output file is then sized once, and each
+ * range is encoded again by a forked worker that writes its pairs with
+ * pwrite at the offset given by the sizes of the ranges before it, with at
+ * most rle_worker_count() workers running at once. The input is therefore
+ * read twice, but the output is written once and no temporary files are
+ * needed. A range whose worker fails or crashes is encoded again by a new
+ * worker, up to retries times; it overwrites the same place. A worker whose
+ * range no longer has the size found by the first pass fails, so an input
+ * changed in between is reported rather than written with gaps. A run
+ * crossing a range boundary becomes two pairs, which decodes to the same
+ * data. Each worker has its own copy of io_throttle, so the I/O limits are
+ * split evenly between the workers that can run at once.
+ * 
+ * @param input_path File to encode.
+ * @param output_path Encoded output file.
+ * @param shards Number of shards.
+ * @param retries Extra attempts allowed per shard.
+ * @return True on success.
+ */
+bool encode_rle_sharded(const std::string& input_path, const std::string& output_path, unsigned shards, unsigned retries) {
+    int in_fd = open(input_path.c_str(), O_RDONLY);
+    struct stat info;
+    if (in_fd < 0 || fstat(in_fd, &info) != 0 || shards == 0) {
+        g_printerr("Failed to open file.\n");
+        if (in_fd >= 0) {
+            close(in_fd);
+        }
+        return false;
+    }
+
+    uint64_t size = info.st_size;
+    std::vector<uint64_t> offsets(shards + 1, 0);
+    std::atomic<bool> read_ok(true);
+    parallel_for(shards, 1, [&](size_t begin, size_t end) {
+        for (size_t i = begin; i < end; ++i) {
+            uint64_t encoded = 0;
+            if (!encode_file_range(in_fd, size * i / shards, size * (i + 1) / shards, [&](const unsigned char *, size_t count) {
+                encoded += count;
+            })) {
+                read_ok = false;
+            }
+            offsets[i + 1] = encoded;
+        }
+    }, rle_worker_count());
+    for (unsigned i = 0; i < shards; ++i) {
+        offsets[i + 1] += offsets[i];
+    }
+
+    int out_fd = read_ok ? open(output_path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644) : -1;
+    if (out_fd < 0 || ftruncate(out_fd, offsets[shards]) != 0) {
+        g_printerr(read_ok ? "Failed to write output file.\n" : "Failed to read file.\n");
+        if (out_fd >= 0) {
+            close(out_fd);
+            unlink(output_path.c_str());
+        }
+        close(in_fd);
+        return false;
+    }
+
+    std::vector<unsigned> attempts(shards, 0);
+    std::deque<unsigned> pending;
+    std::map<pid_t, unsigned> running;
+    for (unsigned i = 0; i < shards; ++i) {
+        pending.push_back(i);
+    }
+
+    unsigned concurrent = std::min(shards, rle_worker_count());
+    rle_io_limits share = io_throttle.limits();
+    share.read_bytes_per_second /= concurrent;
+    share.write_bytes_per_second /= concurrent;
+    share.reads_per_second /= concurrent;
+    share.writes_per_second /= concurrent;
+    share.idle_priority = false;
+
+    std::cout.flush();
+    bool ok = true;
+    while (ok && (!pending.empty() || !running.empty())) {
+        while (!pending.empty() && running.size() < rle_worker_count()) {
+            unsigned shard = pending.front();
+            pending.pop_front();
+            ++attempts[shard];
+
+            pid_t pid = fork();
+            if (pid == 0) {
+                io_throttle.configure(share);
+                bool done = encode_file_range_at(in_fd, size * shard / shards, size * (shard + 1) / shards,
+                                                 out_fd, offsets[shard], offsets[shard + 1] - offsets[shard]);
+                _exit(done ? 0 : 1);
+            }
+            if (pid < 0) {
+                g_printerr("Failed to start worker process.\n");
+                ok = false;
+                break;
+            }
+            running[pid] = shard;
+        }
+
+        int status;
+        pid_t pid = waitpid(-1, &status, 0);
+        if (pid < 0) {
+            break;
+        }
+        unsigned shard = running[pid];
+        running.erase(pid);
+
+        if (!WIFEXITED(status) || WEXITSTATUS(status) != 0) {
+            if (attempts[shard] > retries) {
+                g_printerr("Shard %u failed after %u attempts.\n", shard, attempts[shard]);
+                ok = false;
+            } else {
+                g_printerr("Shard %u failed, retrying.\n", shard);
+                pending.push_back(shard);
+            }
+        }
+    }
+    while (!running.empty()) {
+        int status;
+        pid_t pid = waitpid(-1, &status, 0);
+        if (pid < 0) {
+            break;
+        }
+        running.erase(pid);
+    }
+    close(in_fd);
+
+    ok = (close(out_fd) == 0) && ok;
+    if (ok) {
+        rle_write_index(output_path, size);
+    } else {
+        g_printerr("Failed to write output file.\n");
+        unlink(output_path.c_str());
+    }
+    return ok;
+}
+
+/**
+ * @brief Header of an ELF-aware archive.
+ * 
+ * It is followed by piece_count rle_elf_piece entries and then the encoded
+ * pieces. All fields are in host byte order.
+ */
+struct rle_elf_header {
+    char magic[8];          ///< RLE_ELF_MAGIC.
+    uint64_t original_size; ///< Size of the original file.
+    uint64_t piece_count;   ///< Number of pieces.
+};
+
+/**
+ * @brief Independently encoded byte range of an ELF file.
+ */
+struct rle_elf_piece {
+    uint64_t file_offset;    ///< Offset of the piece in the original file.
+    uint64_t file_size;      ///< Bytes of the original file covered.
+    uint64_t encoded_offset; ///< Offset of the encoded piece in the archive.
+    uint64_t encoded_size;   ///< Encoded bytes.
+    uint64_t vaddr;          ///< Segment virtual address.
+    uint64_t memsz;          ///< Segment size in memory.
+    uint32_t type;           ///< Program header type, PT_NULL for bytes outside segments.
+    uint32_t flags;          ///< Segment flags.
+    int64_t segment;         ///< Program header index, -1 for bytes outside segments.
+};
+
+static const char RLE_ELF_MAGIC[8] = {'R', 'L', 'E', 'E', 'L', 'F', '1', '\0'}; ///< Archive magic.
+
+/**
+ * @brief Find the ranges of a file that hold data rather than holes.
+ * 
+ * @param fd File descriptor.
+ * @param size File size.
+ * @return Sorted [begin, end) data ranges; the whole file if holes cannot be detected.
+ */
+std::vector<std::pair<uint64_t, uint64_t>> file_data_extents(int fd, uint64_t size) {
+    std::vector<std::pair<uint64_t, uint64_t>> extents;
+
+    for (uint64_t offset = 0; offset < size;) {
+        off_t data = lseek(fd, offset, SEEK_DATA);
+        if (data < 0) {
+            if (errno == ENXIO) {
+                break;
+            }
+            return {{0, size}};
+        }
+        off_t hole = lseek(fd, data, SEEK_HOLE);
+        uint64_t end = (hole < 0) ? size : std::min<uint64_t>(hole, size);
+        extents.push_back({static_cast<uint64_t>(data), end});
+        offset = end;
+    }
+
+    return extents;
+}
+
+/**
+ * @brief Append pairs encoding a number of zero bytes.
+ * 
+ * @param out Encoded output.
+ * @param count Number of zero bytes.
+ */
+void append_zero_runs(std::vector<unsigned char>& out, uint64_t count) {
+    for (; count > 0; count -= std::min<uint64_t>(count, RLE_MAX_RUN)) {
+        out.push_back(static_cast<unsigned char>(std::min<uint64_t>(count, RLE_MAX_RUN)));
+        out.push_back(0);
+    }
+}
+
+/**
+ * @brief Find the first data range ending after an offset.
+ * 
+ * @param extents Data ranges from file_data_extents().
+ * @param offset File offset.
+ * @return Iterator to the range, or end.
+ */
+static std::vector<std::pair<uint64_t, uint64_t>>::const_iterator
+first_extent_after(const std::vector<std::pair<uint64_t, uint64_t>>& extents, uint64_t offset) {
+    return std::partition_point(extents.begin(), extents.end(), [offset](const std::pair<uint64_t, uint64_t>& extent) {
+        return extent.second <= offset;
+    });
+}
+
+/**
+ * @brief Count the bytes of a range that hold data rather than holes.
+ * 
+ * @param extents Data ranges from file_data_extents().
+ * @param begin Offset of the first byte.
+ * @param end Offset past the last byte.
+ * @return Number of data bytes.
+ */
+uint64_t data_bytes_in_range(const std::vector<std::pair<uint64_t, uint64_t>>& extents, uint64_t begin, uint64_t end) {
+    uint64_t bytes = 0;
+    for (auto extent = first_extent_after(extents, begin); extent != extents.end() && extent->first < end; ++extent) {
+        bytes += std::min(extent->second, end) - std::max(extent->first, begin);
+    }
+    return bytes;
+}
+
+/**
+ * @brief Encode a byte range of a mapped file, emitting holes as zero runs without reading them.
+ * 
+ * @param file Mapped file.
+ * @param extents Data ranges from file_data_extents().
+ * @param begin Offset of the first byte.
+ * @param end Offset past the last byte.
+ * @return Encoded bytes.
+ */
+std::vector<unsigned char> encode_sparse_range(const rle_mapped_file& file, const std::vector<std::pair<uint64_t, uint64_t>>& extents,
+                                               uint64_t begin, uint64_t end) {
+    std::vector<unsigned char> out;
+    uint64_t position = begin;
+
+    for (auto extent = first_extent_after(extents, begin); extent != extents.end() && extent->first < end; ++extent) {
+        uint64_t data_begin = std::max(extent->first, position);
+        uint64_t data_end = std::min(extent->second, end);
+        append_zero_runs(out, data_begin - position);
+
+        size_t used = out.size();
+        out.resize(used + rle_encoded_size(file.data + data_begin, data_end - data_begin));
+        encode_rle_into(file.data + data_begin, data_end - data_begin, out.data() + used);
+        position = data_end;
+    }
+    append_zero_runs(out, end - position);
+
+    return out;
+}
+
+/**
+ * @brief Split a 64-bit ELF file into pieces at its loadable segments.
+ * 
+ * @param file Mapped ELF file.
+ * @param pieces Pieces covering the whole file in order.
+ * @return True if the file is a well formed 64-bit ELF file.
+ */
+bool elf_pieces(const rle_mapped_file& file, std::vector<rle_elf_piece>& pieces) {
+    if (file.size < sizeof(Elf64_Ehdr) || std::memcmp(file.data, ELFMAG, SELFMAG) != 0 ||
+        file.data[EI_CLASS] != ELFCLASS64) {
+        return false;
+    }
+
+    Elf64_Ehdr header;
+    std::memcpy(&header, file.data, sizeof(header));
+    if (header.e_phentsize != sizeof(Elf64_Phdr) || header.e_phoff > file.size ||
+        header.e_phnum > (file.size - header.e_phoff) / sizeof(Elf64_Phdr)) {
+        return false;
+    }
+
+    std::vector<rle_elf_piece> segments;
+    for (int i = 0; i < header.e_phnum; ++i) {
+        Elf64_Phdr phdr;
+        std::memcpy(&phdr, file.data + header.e_phoff + i * sizeof(Elf64_Phdr), sizeof(phdr));
+        if (phdr.p_type != PT_LOAD || phdr.p_filesz == 0 || phdr.p_offset >= file.size) {
+            continue;
+        }
+        uint64_t size = std::min<uint64_t>(phdr.p_filesz, file.size - phdr.p_offset);
+        segments.push_back({phdr.p_offset, size, 0, 0, phdr.p_vaddr, phdr.p_memsz, phdr.p_type, phdr.p_flags, i});
+    }
+    std::sort(segments.begin(), segments.end(), [](const rle_elf_piece& a, const rle_elf_piece& b) {
+        return a.file_offset < b.file_offset;
+    });
+
+    uint64_t position = 0;
+    for (rle_elf_piece segment : segments) {
+        if (segment.file_offset + segment.file_size <= position) {
+            continue;
+        }
+        if (segment.file_offset > position) {
+            pieces.push_back({position, segment.file_offset - position, 0, 0, 0, 0, PT_NULL, 0, -1});
+        } else {
+            segment.file_size -= position - segment.file_offset;
+            segment.file_offset = position;
+        }
+        pieces.push_back(segment);
+        position = segment.file_offset + segment.file_size;
+    }
+    if (position < file.size) {
+        pieces.push_back({position, file.size - position, 0, 0, 0, 0, PT_NULL, 0, -1});
+    }
+
+    return true;
+}
+
+static const size_t RLE_ELF_CHUNK = 1 << 20;          ///< Original bytes encoded per job.
+static const size_t RLE_ELF_DECODE_CHUNK = 64 * 1024; ///< Encoded bytes decoded per job.
+
+/**
+ * @brief Encode an ELF file, such as a core dump, segment by segment.
+ * 
+ * Every loadable segment and every range between segments is encoded
+ * independently. Pieces are cut into RLE_ELF_CHUNK chunks that are encoded
+ * a window at a time in parallel, so memory use does not depend on the
+ * segment sizes, and file holes are emitted as zero runs without being
+ * read. The archive records each piece's segment metadata and encoded
+ * location, so single segments can be decoded later by
+ * decode_rle_elf_segment().
+ * 
+ * @param input_path ELF file.
+ * @param output_path Archive to write.
+ * @return True on success.
+ */
+bool encode_rle_elf(const std::string& input_path, const std::string& output_path) {
+    rle_mapped_file input(input_path);
+    std::vector<rle_elf_piece> pieces;
+    if (!input.valid || !elf_pieces(input, pieces)) {
+        g_printerr("Not a 64-bit ELF file.\n");
+        return false;
+    }
+
+    int fd = open(input_path.c_str(), O_RDONLY);
+    std::vector<std::pair<uint64_t, uint64_t>> extents = file_data_extents(fd, input.size);
+    close(fd);
+
+    std::ofstream file_out(output_path, std::ios::binary | std::ios::trunc);
+    if (!file_out.is_open()) {
+        g_printerr("Failed to open file.\n");
+        return false;
+    }
+
+    rle_elf_header header;
+    std::memcpy(header.magic, RLE_ELF_MAGIC, sizeof(header.magic));
+    header.original_size = input.size;
+    header.piece_count = pieces.size();
+    uint64_t offset = sizeof(header) + pieces.size() * sizeof(rle_elf_piece);
+    file_out.seekp(offset);
+
+    struct chunk {
+        size_t piece;   ///< Index of the piece the chunk belongs to.
+        uint64_t begin; ///< Offset of the first byte.
+        uint64_t end;   ///< Offset past the last byte.
+    };
+    size_t window = 2 * rle_worker_count();
+    std::vector<chunk> chunks(window);
+    std::vector<std::vector<unsigned char>> encoded(window);
+    size_t piece = 0;
+    uint64_t position = pieces.empty() ? 0 : pieces[0].file_offset;
+
+    while (piece < pieces.size()) {
+        size_t count = 0;
+        uint64_t read_bytes = 0;
+        for (; count < window && piece < pieces.size(); ++count) {
+            uint64_t piece_end = pieces[piece].file_offset + pieces[piece].file_size;
+            uint64_t end = std::min<uint64_t>(position + RLE_ELF_CHUNK, piece_end);
+            chunks[count] = {piece, position, end};
+            read_bytes += data_bytes_in_range(extents, position, end);
+            position = end;
+            if (position == piece_end && ++piece < pieces.size()) {
+                position = pieces[piece].file_offset;
+            }
+        }
+        io_throttle.before_read(read_bytes);
+
+        parallel_for(count, 1, [&](size_t begin, size_t end) {
+            for (size_t i = begin; i < end; ++i) {
+                encoded[i] = encode_sparse_range(input, extents, chunks[i].begin, chunks[i].end);
+            }
+        });
+
+        for (size_t i = 0; i < count; ++i) {
+            rle_elf_piece &target = pieces[chunks[i].piece];
+            if (chunks[i].begin == target.file_offset) {
+                target.encoded_offset = offset;
+            }
+            target.encoded_size += encoded[i].size();
+            throttled_write(file_out, encoded[i].data(), encoded[i].size());
+            offset += encoded[i].size();
+        }
+        input.release_before(chunks[count - 1].end);
+    }
+
+    file_out.seekp(0);
+    throttled_write(file_out, &header, sizeof(header));
+    throttled_write(file_out, pieces.data(), pieces.size() * sizeof(rle_elf_piece));
+    return file_out.good();
+}
+
+/**
+ * @brief Read and check the piece table of an ELF-aware archive.
+ * 
+ * @param archive Mapped archive.
+ * @param header Archive header.
+ * @param pieces Piece table.
+ * @return True if the table is well formed and every piece lies within the archive.
+ */
+bool read_rle_elf_pieces(const rle_mapped_file& archive, rle_elf_header& header, std::vector<rle_elf_piece>& pieces) {
+    if (archive.size < sizeof(header)) {
+        return false;
+    }
+    std::memcpy(&header, archive.data, sizeof(header));
+    if (std::memcmp(header.magic, RLE_ELF_MAGIC, sizeof(header.magic)) != 0 ||
+        header.piece_count > (archive.size - sizeof(header)) / sizeof(rle_elf_piece)) {
+        return false;
+    }
+
+    pieces.resize(header.piece_count);
+    std::memcpy(pieces.data(), archive.data + sizeof(header), pieces.size() * sizeof(rle_elf_piece));
+    for (const rle_elf_piece& piece : pieces) {
+        if (piece.encoded_offset > archive.size || piece.encoded_size > archive.size - piece.encoded_offset) {
+            return false;
+        }
+    }
+    return true;
+}
+
+/**
+ * @brief Decode one piece of an ELF-aware archive to a stream.
+ * 
+ * The encoded bytes are validated and decoded RLE_ELF_DECODE_CHUNK at a
+ * time, a window of chunks in parallel, so memory use does not depend on
+ * the piece size.
+ * 
+ * @param archive Mapped archive.
+ * @param piece Piece to decode.
+ * @param out Stream receiving the decoded bytes.
+ * @return True if the piece was valid and decoded to its recorded size.
+ */
+bool decode_rle_elf_piece(rle_mapped_file& archive, const rle_elf_piece& piece, std::ostream& out) {
+    if (piece.encoded_size % 2 != 0) {
+        return false;
+    }
+
+    size_t window = 2 * rle_worker_count();
+    std::vector<std::vector<unsigned char>> decoded(window);
+    const unsigned char *data = archive.data + piece.encoded_offset;
+    uint64_t total = 0;
+
+    for (uint64_t first = 0; first < piece.encoded_size; first += window * RLE_ELF_DECODE_CHUNK) {
+        size_t count = std::min<uint64_t>(window, (piece.encoded_size - first + RLE_ELF_DECODE_CHUNK - 1) / RLE_ELF_DECODE_CHUNK);
+        io_throttle.before_read(std::min<uint64_t>(piece.encoded_size - first, count * RLE_ELF_DECODE_CHUNK));
+        std::atomic<bool> ok(true);
+
+        parallel_for(count, 1, [&](size_t begin, size_t end) {
+            for (size_t i = begin; i < end; ++i) {
+                uint64_t offset = first + i * RLE_ELF_DECODE_CHUNK;
+                size_t size = std::min<uint64_t>(RLE_ELF_DECODE_CHUNK, piece.encoded_size - offset);
+                uint64_t decoded_size = 0;
+                if (rle_validate(data + offset, size, rle_decode_limit, &decoded_size) != RLE_VALID) {
+                    ok = false;
+                    continue;
+                }
+                decoded[i].resize(decoded_size);
+                decode_rle_into(data + offset, size, decoded[i].data());
+            }
+        });
+        if (!ok) {
+            return false;
+        }
+
+        for (size_t i = 0; i < count; ++i) {
+            total += decoded[i].size();
+            if (total > piece.file_size) {
+                return false;
+            }
+            throttled_write(out, decoded[i].data(), decoded[i].size());
+        }
+        archive.release_before(piece.encoded_offset + std::min<uint64_t>(piece.encoded_size, first + count * RLE_ELF_DECODE_CHUNK));
+    }
+
+    return total == piece.file_size;
+}
+
+/**
+ * @brief Decode a whole ELF-aware archive back to the original file.
+ * 
+ * @param input_path Archive.
+ * @param output_path Decoded output file.
+ * @return True on success.
+ */
+bool decode_rle_elf(const std::string& input_path, const std::string& output_path) {
+    rle_mapped_file archive(input_path);
+    rle_elf_header header;
+    std::vector<rle_elf_piece> pieces;
+    std::ofstream file_out(output_path, std::ios::binary | std::ios::trunc);
+    if (!archive.valid || !read_rle_elf_pieces(archive, header, pieces) || !file_out.is_open()) {
+        g_printerr("Invalid ELF archive.\n");
+        return false;
+    }
+
+    for (const rle_elf_piece& piece : pieces) {
+        if (!decode_rle_elf_piece(archive, piece, file_out)) {
+            g_printerr("Invalid ELF archive piece.\n");
+            return false;
+        }
+    }
+
+    return file_out.good();
+}
+
+/**
+ * @brief Decode a single segment of an ELF-aware archive.
+ * 
+ * Only the encoded bytes of that segment are read.
+ * 
+ * @param input_path Archive.
+ * @param segment Program header index of the segment.
+ * @param output_path File receiving the segment's bytes.
+ * @return True on success.
+ */
+bool decode_rle_elf_segment(const std::string& input_path, int64_t segment, const std::string& output_path) {
+    rle_mapped_file archive(input_path);
+    rle_elf_header header;
+    std::vector<rle_elf_piece> pieces;
+    if (!archive.valid || !read_rle_elf_pieces(archive, header, pieces)) {
+        g_printerr("Invalid ELF archive.\n");
+        return false;
+    }
+
+    for (const rle_elf_piece& piece : pieces) {
+        if (piece.segment != segment || segment < 0) {
+            continue;
+        }
+        std::ofstream file_out(output_path, std::ios::binary | std::ios::trunc);
+        if (!file_out.is_open()) {
+            g_printerr("Failed to open file.\n");
+            return false;
+        }
+        if (!decode_rle_elf_piece(archive, piece, file_out)) {
+            g_printerr("Invalid ELF archive piece.\n");
+            return false;
+        }
+        return file_out.good();
+    }
+
+    g_printerr("Segment %lld not found.\n", static_cast<long long>(segment));
+    return false;
+}
+
+/**
+ * @brief Print the piece table of an ELF-aware archive.
+ * 
+ * @param input_path Archive.
+ * @return Exit status code.
+ */
+int list_rle_elf(const std::string& input_path) {
+    rle_mapped_file archive(input_path);
+    rle_elf_header header;
+    std::vector<rle_elf_piece> pieces;
+    if (!archive.valid || !read_rle_elf_pieces(archive, header, pieces)) {
+        g_printerr("Invalid ELF archive.\n");
+        return 1;
+    }
+
+    g_print("%8s %18s %18s %14s %14s %6s\n", "segment", "vaddr", "file offset", "file size", "encoded", "flags");
+    for (const rle_elf_piece& piece : pieces) {
+        if (piece.segment < 0) {
+            g_print("%8s %18s %#18llx %14llu %14llu %6s\n", "-", "-",
+                    static_cast<unsigned long long>(piece.file_offset), static_cast<unsigned long long>(piece.file_size),
+                    static_cast<unsigned long long>(piece.encoded_size), "");
+        } else {
+            g_print("%8lld %#18llx %#18llx %14llu %14llu %c%c%c\n", static_cast<long long>(piece.segment),
+                    static_cast<unsigned long long>(piece.vaddr), static_cast<unsigned long long>(piece.file_offset),
+                    static_cast<unsigned long long>(piece.file_size), static_cast<unsigned long long>(piece.encoded_size),
+                    (piece.flags & PF_R) ? 'r' : '-', (piece.flags & PF_W) ? 'w' : '-', (piece.flags & PF_X) ? 'x' : '-');
+        }
+    }
+    return 0;
+}
+
+static const size_t RLE_TAR_BLOCK = 512;          ///< Size of a tar header or padding unit.
+static const size_t RLE_TAR_CHUNK = 1024 * 1024;  ///< Payload bytes encoded per framed chunk.
+
+/**
+ * @brief Check a tar header block's checksum.
+ * 
+ * @param header 512-byte header block.
+ * @return True if the checksum matches or the block is an all-zero end-of-archive block.
+ */
+bool tar_header_valid(const unsigned char *header) {
+    uint64_t sum = 0;
+    bool zero = true;
+    for (size_t i = 0; i < RLE_TAR_BLOCK; ++i) {
+        sum += (i >= 148 && i < 156) ? ' ' : header[i];
+        zero = zero && header[i] == 0;
+    }
+    if (zero) {
+        return true;
+    }
+
+    uint64_t stored = 0;
+    for (size_t i = 148; i < 156 && header[i] != 0 && header[i] != ' '; ++i) {
+        if (header[i] < '0' || header[i] > '7') {
+            return false;
+        }
+        stored = stored * 8 + (header[i] - '0');
+    }
+    return stored == sum;
+}
+
+/**
+ * @brief Get the payload size of a tar member, padded to whole blocks.
+ * 
+ * Both the octal and the GNU base-256 size encodings are accepted.
+ * 
+ * @param header 512-byte header block.
+ * @return Number of bytes following the header.
+ */
+uint64_t tar_payload_size(const unsigned char *header) {
+    uint64_t size = 0;
+    if (header[124] & 0x80) {
+        for (size_t i = 128; i < 136; ++i) {
+            size = (size << 8) | header[i];
+        }
+    } else {
+        size_t i = 124;
+        for (; i < 136 && header[i] == ' '; ++i) {
+        }
+        for (; i < 136 && header[i] >= '0' && header[i] <= '7'; ++i) {
+            size = size * 8 + (header[i] - '0');
+        }
+    }
+    return (size + RLE_TAR_BLOCK - 1) / RLE_TAR_BLOCK * RLE_TAR_BLOCK;
+}
+
+/**
+ * @brief Writer that keeps the output of asynchronous jobs in submission order.
+ * 
+ * Raw pieces are written as they are; job results are framed with their
+ * length when encoding. At most a fixed number of pieces are in flight, so
+ * memory stays bounded however long the stream is.
+ */
+class rle_ordered_writer {
+public:
+    /**
+     * @brief Create a writer.
+     * 
+     * @param out Output stream.
+     * @param framed Whether job results are prefixed with their 64-bit length.
+     */
+    rle_ordered_writer(std::ostream& out, bool framed) : out(out), framed(framed), window(2 * rle_worker_count()) {
+    }
+
+    ~rle_ordered_writer() {
+        abandon();
+    }
+
+    /**
+     * @brief Queue bytes written unchanged.
+     * 
+     * @param data Bytes.
+     * @param size Number of bytes.
+     */
+    void push_raw(const unsigned char *data, size_t size) {
+        std::unique_ptr<slot> next(new slot);
+        next->data.assign(data, data + size);
+        next->raw = true;
+        pieces.push_back(std::move(next));
+        drain(window);
+    }
+
+    /**
+     * @brief Queue a job transforming a buffer on the worker pool.
+     * 
+     * @param input Input buffer, moved into the job.
+     * @param transform Job body; returns false if the input is invalid.
+     */
+    void push_job(std::vector<unsigned char> input,
+                  std::function<bool(const std::vector<unsigned char>&, std::vector<unsigned char>&)> transform) {
+        std::unique_ptr<slot> next(new slot);
+        slot *target = next.get();
+        target->data.swap(input);
+        target->outstanding = 1;
+        pieces.push_back(std::move(next));
+
+        rle_default_scheduler().submit(RLE_JOB_BULK, [target, transform] {
+            std::vector<unsigned char> result;
+            target->ok = transform(target->data, result);
+            target->data.swap(result);
+            target->outstanding.fetch_sub(1);
+        });
+        drain(window);
+    }
+
+    /**
+     * @brief Wait for every queued piece and write it.
+     * 
+     * @return True if every job succeeded and the output is still good.
+     */
+    bool finish() {
+        drain(0);
+        return ok && out.good();
+    }
+
+    /**
+     * @brief Wait for every queued job and discard the queued pieces unwritten.
+     * 
+     * Used on error paths; the destructor calls it too, so output is only
+     * complete after finish().
+     */
+    void abandon() {
+        ok = false;
+        drain(0);
+    }
+
+private:
+    /**
+     * @brief Queued piece of output.
+     */
+    struct slot {
+        std::vector<unsigned char> data;    ///< Raw bytes, or the job input and then its result.
+        std::atomic<size_t> outstanding{0}; ///< 1 while the job is queued or running.
+        bool raw = false;                   ///< Whether the bytes are written unchanged.
+        bool ok = true;                     ///< Whether the job succeeded.
+    };
+
+    /**
+     * @brief Write finished pieces from the front until at most keep remain.
+     */
+    void drain(size_t keep) {
+        while (pieces.size() > keep) {
+            slot &front = *pieces.front();
+            rle_default_scheduler().help_until_done(front.outstanding);
+            ok = ok && front.ok;
+            if (ok) {
+                if (framed && !front.raw) {
+                    uint64_t length = front.data.size();
+                    throttled_write(out, &length, sizeof(length));
+                }
+                throttled_write(out, front.data.data(), front.data.size());
+            }
+            pieces.pop_front();
+        }
+    }
+
+    std::ostream &out;                        ///< Output stream.
+    bool framed;                              ///< Whether job results are length-prefixed.
+    size_t window;                            ///< Most pieces queued at once.
+    bool ok = true;                           ///< Cleared by a failed job or abandon(); stops writing.
+    std::deque<std::unique_ptr<slot>> pieces; ///< Queued pieces in output order.
+};
+
+/**
+ * @brief Encode a tar stream member by member.
+ * 
+ * Headers are copied unchanged and each member's payload is encoded on the
+ * worker pool in chunks of RLE_TAR_CHUNK bytes, each framed by its 64-bit
+ * encoded length, so runs never span a header.
+ * 
+ * @param in Tar stream.
+ * @param out Encoded stream.
+ * @return True on success.
+ */
+bool encode_rle_tar(std::istream& in, std::ostream& out) {
+    rle_ordered_writer writer(out, true);
+    unsigned char header[RLE_TAR_BLOCK];
+
+    for (;;) {
+        size_t got = throttled_read(in, header, sizeof(header));
+        if (got == 0) {
+            break;
+        }
+        if (got != sizeof(header) || !tar_header_valid(header)) {
+            writer.abandon();
+            g_printerr("Not a tar stream.\n");
+            return false;
+        }
+        writer.push_raw(header, sizeof(header));
+
+        for (uint64_t remaining = tar_payload_size(header); remaining > 0;) {
+            std::vector<unsigned char> chunk(std::min<uint64_t>(remaining, RLE_TAR_CHUNK));
+            if (throttled_read(in, chunk.data(), chunk.size()) != chunk.size()) {
+                writer.abandon();
+                g_printerr("Truncated tar stream.\n");
+                return false;
+            }
+            remaining -= chunk.size();
+            writer.push_job(std::move(chunk), [](const std::vector<unsigned char>& data, std::vector<unsigned char>& encoded) {
+                encoded = encode_rle(data);
+                return true;
+            });
+        }
+    }
+
+    return writer.finish();
+}
+
+/**
+ * @brief Restore a tar stream written by encode_rle_tar().
+ * 
+ * @param in Encoded stream.
+ * @param out Tar stream.
+ * @return True on success.
+ */
+bool decode_rle_tar(std::istream& in, std::ostream& out) {
+    rle_ordered_writer writer(out, false);
+    unsigned char header[RLE_TAR_BLOCK];
+
+    for (;;) {
+        size_t got = throttled_read(in, header, sizeof(header));
+        if (got == 0) {
+            break;
+        }
+        if (got != sizeof(header) || !tar_header_valid(header)) {
+            writer.abandon();
+            g_printerr("Invalid encoded tar stream.\n");
+            return false;
+        }
+        writer.push_raw(header, sizeof(header));
+
+        for (uint64_t remaining = tar_payload_size(header); remaining > 0;) {
+            uint64_t expected = std::min<uint64_t>(remaining, RLE_TAR_CHUNK);
+            uint64_t length = 0;
+            if (throttled_read(in, reinterpret_cast<unsigned char*>(&length), sizeof(length)) != sizeof(length) ||
+                length > 2 * expected) {
+                writer.abandon();
+                g_printerr("Invalid encoded tar stream.\n");
+                return false;
+            }
+            std::vector<unsigned char> chunk(length);
+            if (throttled_read(in, chunk.data(), chunk.size()) != chunk.size()) {
+                writer.abandon();
+                g_printerr("Truncated encoded tar stream.\n");
+                return false;
+            }
+            remaining -= expected;
+            writer.push_job(std::move(chunk), [expected](const std::vector<unsigned char>& data, std::vector<unsigned char>& decoded) {
+                uint64_t decoded_size = 0;
+                if (rle_validate(data.data(), data.size(), expected, &decoded_size) != RLE_VALID || decoded_size != expected) {
+                    return false;
+                }
+                decoded.resize(decoded_size);
+                decode_rle_into(data.data(), data.size(), decoded.data());
+                return true;
+            });
+        }
+    }
+
+    if (!writer.finish()) {
+        writer.abandon();
+        g_printerr("Invalid encoded tar stream.\n");
+        return false;
+    }
+    return true;
+}
+
+/**
+ * @brief Run the tar encoder or decoder between files or standard streams.
+ * 
+ * @param encode True to encode, false to decode.
+ * @param input_path Input file, or "-" for standard input.
+ * @param output_path Output file, or "-" for standard output.
+ * @return Exit status code.
+ */
+int tar_command(bool encode, const std::string& input_path, const std::string& output_path) {
+    std::ifstream file_in;
+    std::ofstream file_out;
+    if (input_path != "-") {
+        file_in.open(input_path, std::ios::binary);
+    }
+    if (output_path != "-") {
+        file_out.open(output_path, std::ios::binary | std::ios::trunc);
+    }
+    if ((input_path != "-" && !file_in.is_open()) || (output_path != "-" && !file_out.is_open())) {
+        g_printerr("Failed to open file.\n");
+        return 1;
+    }
+
+    std::istream &in = (input_path == "-") ? std::cin : file_in;
+    std::ostream &out = (output_path == "-") ? std::cout : file_out;
+    bool ok = encode ? encode_rle_tar(in, out) : decode_rle_tar(in, out);
+    out.flush();
+    return ok ? 0 : 1;
+}
+
+/**
+ * @brief Convert bytes to hex for armoring.
+ */
+static size_t armor_hex_to_text(const unsigned char *bytes, size_t size, char *text) {
+    bytes_to_hex_into(bytes, size, text);
+    return 2 * size;
+}
+
+/**
+ * @brief Convert armored hex back to bytes.
+ */
+static bool armor_hex_from_text(const char *text, size_t size, unsigned char *bytes, size_t& written) {
+    written = size / 2;
+    return size % 2 == 0 && hex_to_bytes_into(text, written, bytes);
+}
+
+/**
+ * @brief Text armoring of encoded files.
+ */
+struct rle_armor {
+    const char *name;   ///< Name given on the command line.
+    size_t line_bytes;  ///< Encoded bytes per line.
+    size_t line_chars;  ///< Characters per full line, without the newline.
+    size_t group_chars; ///< Characters that always convert to whole RLE pairs.
+    size_t (*to_text)(const unsigned char *bytes, size_t size, char *text);                 ///< Converts bytes to text, returning the characters written.
+    bool (*from_text)(const char *text, size_t size, unsigned char *bytes, size_t& written); ///< Converts text back to bytes, failing on invalid text.
+};
+
+static const rle_armor rle_armors[] = {
+    {"hex", 32, 64, 4, armor_hex_to_text, armor_hex_from_text},
+    {"base64", 57, 76, 8, bytes_to_base64_into, base64_to_bytes_into},
+}; ///< Supported armorings.
+
+static const size_t RLE_ARMOR_BLOCK_LINES = 4096; ///< Lines armored or dearmored by one job.
+
+/**
+ * @brief Find an armoring by name.
+ * 
+ * @param name Armoring name.
+ * @return The armoring, or NULL if unknown.
+ */
+const rle_armor *find_rle_armor(const std::string& name) {
+    for (const rle_armor& armor : rle_armors) {
+        if (name == armor.name) {
+            return &armor;
+        }
+    }
+    return NULL;
+}
+
+/**
+ * @brief Encode a file and write it as armored text lines.
+ * 
+ * The input is encoded as a stream and the encoded bytes are cut into
+ * blocks of whole lines, which are converted to text on the worker pool
+ * and written in order, so memory use does not depend on the file size.
+ * 
+ * @param input_path File to encode.
+ * @param output_path Armored output file.
+ * @param armor Armoring.
+ * @return True on success.
+ */
+bool encode_rle_armored(const std::string& input_path, const std::string& output_path, const rle_armor& armor) {
+    std::ifstream file_in(input_path, std::ios::binary);
+    std::ofstream file_out(output_path, std::ios::binary | std::ios::trunc);
+    if (!file_in.is_open() || !file_out.is_open()) {
+        g_printerr("Failed to open file.\n");
+        return false;
+    }
+
+    const rle_armor *format = &armor;
+    const size_t block_bytes = armor.line_bytes * RLE_ARMOR_BLOCK_LINES;
+    rle_ordered_writer writer(file_out, false);
+    std::vector<unsigned char> block;
+
+    auto submit = [&] {
+        writer.push_job(std::move(block), [format](const std::vector<unsigned char>& data, std::vector<unsigned char>& text) {
+            size_t lines = (data.size() + format->line_bytes - 1) / format->line_bytes;
+            text.resize(lines * (format->line_chars + 1));
+            char *out = reinterpret_cast<char*>(text.data());
+            for (size_t i = 0; i < data.size(); i += format->line_bytes) {
+                out += format->to_text(data.data() + i, std::min(format->line_bytes, data.size() - i), out);
+                *out++ = '\n';
+            }
+            text.resize(out - reinterpret_cast<char*>(text.data()));
+            return true;
+        });
+        block.clear();
+        block.reserve(block_bytes);
+    };
+
+    block.reserve(block_bytes);
+    rle_stream_encoder encoder([&](const unsigned char *bytes, size_t count) {
+        while (count > 0) {
+            size_t take = std::min(count, block_bytes - block.size());
+            block.insert(block.end(), bytes, bytes + take);
+            bytes += take;
+            count -= take;
+            if (block.size() == block_bytes) {
+                submit();
+            }
+        }
+    });
+
+    std::vector<unsigned char> chunk(block_bytes);
+    while (size_t count = throttled_read(file_in, chunk.data(), chunk.size())) {
+        encoder.write(chunk.data(), count);
+    }
+    encoder.flush();
+    if (!block.empty()) {
+        submit();
+    }
+
+    return writer.finish();
+}
+
+/**
+ * @brief Decode an armored file written by encode_rle_armored().
+ * 
+ * Line breaks are dropped and the remaining text is cut into blocks that
+ * hold whole RLE pairs, which are converted and decoded on the worker
+ * pool and written in order.
+ * 
+ * @param input_path Armored file.
+ * @param output_path Decoded output file.
+ * @param armor Armoring.
+ * @return True on success.
+ */
+bool decode_rle_armored(const std::string& input_path, const std::string& output_path, const rle_armor& armor) {
+    std::ifstream file_in(input_path, std::ios::binary);
+    std::ofstream file_out(output_path, std::ios::binary | std::ios::trunc);
+    if (!file_in.is_open() || !file_out.is_open()) {
+        g_printerr("Failed to open file.\n");
+        return false;
+    }
+
+    const rle_armor *format = &armor;
+    const size_t block_chars = armor.line_chars * RLE_ARMOR_BLOCK_LINES / armor.group_chars * armor.group_chars;
+    std::atomic<int> failure(RLE_VALID);
+    rle_ordered_writer writer(file_out, false);
+    std::vector<unsigned char> block;
+
+    auto submit = [&] {
+        writer.push_job(std::move(block), [format, &failure](const std::vector<unsigned char>& text, std::vector<unsigned char>& decoded) {
+            std::vector<unsigned char> encoded(text.size() / 4 * 3 + 2);
+            size_t encoded_size = 0;
+            uint64_t decoded_size = 0;
+            if (!format->from_text(reinterpret_cast<const char*>(text.data()), text.size(), encoded.data(), encoded_size)) {
+                return false;
+            }
+            rle_validation result = rle_validate(encoded.data(), encoded_size, rle_decode_limit, &decoded_size);
+            if (result != RLE_VALID) {
+                failure = result;
+                return false;
+            }
+            decoded.resize(decoded_size);
+            decode_rle_into(encoded.data(), encoded_size, decoded.data());
+            return true;
+        });
+        block.clear();
+        block.reserve(block_chars);
+    };
+
+    block.reserve(block_chars);
+    std::vector<unsigned char> chunk(block_chars);
+    while (size_t count = throttled_read(file_in, chunk.data(), chunk.size())) {
+        for (size_t i = 0; i < count;) {
+            if (chunk[i] == '\n' || chunk[i] == '\r') {
+                ++i;
+                continue;
+            }
+            const void *newline = std::memchr(chunk.data() + i, '\n', count - i);
+            size_t end = newline ? static_cast<const unsigned char*>(newline) - chunk.data() : count;
+            if (end > i && chunk[end - 1] == '\r') {
+                --end;
+            }
+            size_t take = std::min(end - i, block_chars - block.size());
+            block.insert(block.end(), chunk.data() + i, chunk.data() + i + take);
+            i += take;
+            if (block.size() == block_chars) {
+                submit();
+            }
+        }
+    }
+    if (!block.empty()) {
+        submit();
+    }
+
+    if (!writer.finish()) {
+        if (failure != RLE_VALID) {
+            g_printerr("%s\n", rle_validation_message(static_cast<rle_validation>(failure.load())));
+        } else {
+            g_printerr("Invalid armored file.\n");
+        }
+        return false;
+    }
+    return true;
+}
+
+static const size_t RLE_READER_BLOCK = 8192;        ///< Encoded bytes per random-access block.
+static const size_t RLE_READER_CACHE_BLOCKS = 64;   ///< Decoded blocks kept in the cache.
+static const size_t RLE_READER_MAX_WINDOW = 32;     ///< Most blocks decoded ahead.
+
+/**
+ * @brief Random-access reader for RLE encoded files.
+ * 
+ * The encoded file is mapped and cut into blocks of RLE_READER_BLOCK bytes,
+ * which are validated when the file is opened, giving their decoded
+ * offsets. Decoded blocks are kept in a small cache. When reads move forward
+ * block by block, the following blocks are decoded ahead as bulk jobs on
+ * the shared scheduler. The number of blocks decoded ahead doubles when
+ * the reader catches up with them and halves when one is evicted unread.
+ * The opening pass and every block decode are charged to io_throttle.
+ * rle_decode_limit applies to each block, as at most RLE_READER_CACHE_BLOCKS
+ * decoded blocks are held at once; the decoded file may be larger.
+ */
+class rle_block_reader {
+public:
+    /**
+     * @brief Open an encoded file and index its blocks.
+     * 
+     * @param path Encoded file.
+     */
+    explicit rle_block_reader(const std::string& path) : file(path) {
+        if (!file.valid) {
+            return;
+        }
+
+        size_t blocks = (file.size + RLE_READER_BLOCK - 1) / RLE_READER_BLOCK;
+        std::atomic<int> failure(RLE_VALID);
+        offsets.assign(blocks + 1, 0);
+        size_t window_blocks = 64 * rle_worker_count();
+        for (size_t window = 0; window < blocks; window += window_blocks) {
+            size_t count = std::min(window_blocks, blocks - window);
+            io_throttle.before_read(std::min(file.size - window * RLE_READER_BLOCK, count * RLE_READER_BLOCK));
+            parallel_for(count, 64, [&](size_t begin, size_t end) {
+                for (size_t b = window + begin; b < window + end; ++b) {
+                    uint64_t decoded_size = 0;
+                    rle_validation result = rle_validate(file.data + b * RLE_READER_BLOCK, encoded_size(b),
+                                                         rle_decode_limit, &decoded_size);
+                    if (result != RLE_VALID) {
+                        failure = result;
+                    }
+                    offsets[b + 1] = decoded_size;
+                }
+            });
+        }
+        for (size_t b = 0; b < blocks; ++b) {
+            offsets[b + 1] += offsets[b];
+        }
+
+        if (failure != RLE_VALID) {
+            g_printerr("%s\n", rle_validation_message(static_cast<rle_validation>(failure.load())));
+            offsets.clear();
+            return;
+        }
+        well_formed = true;
+    }
+
+    ~rle_block_reader() {
+        rle_default_scheduler().help_until_done(outstanding);
+    }
+
+    rle_block_reader(const rle_block_reader&) = delete;
+    rle_block_reader& operator=(const rle_block_reader&) = delete;
+
+    /**
+     * @brief Check whether the file was opened and passed validation.
+     */
+    bool valid() const {
+        return file.valid && well_formed;
+    }
+
+    /**
+     * @brief Get the decoded size of the file.
+     */
+    uint64_t size() const {
+        return offsets.empty() ? 0 : offsets.back();
+    }
+
+    /**
+     * @brief Get the number of blocks currently decoded ahead of the reader.
+     */
+    size_t prefetch_window() const {
+        std::lock_guard<std::mutex> lock(mutex);
+        return window;
+    }
+
+    /**
+     * @brief Read decoded bytes.
+     * 
+     * @param offset Offset in the decoded data.
+     * @param out Output buffer.
+     * @param length Number of bytes to read.
+     * @return Number of bytes read, less than length only at the end of the data.
+     */
+    size_t read(uint64_t offset, unsigned char *out, size_t length) {
+        size_t done = 0;
+
+        while (done < length && offset + done < size()) {
+            uint64_t position = offset + done;
+            size_t index = std::upper_bound(offsets.begin(), offsets.end(), position) - offsets.begin() - 1;
+            track_access(index);
+
+            std::shared_ptr<block> current = fetch(index);
+            size_t start = position - offsets[index];
+            size_t count = std::min<size_t>(length - done, current->data.size() - start);
+            std::memcpy(out + done, current->data.data() + start, count);
+            done += count;
+        }
+
+        return done;
+    }
+
+private:
+    /**
+     * @brief Decoding state of a cached block.
+     */
+    enum block_state { queued, decoding, ready };
+
+    /**
+     * @brief Cached decoded block.
+     */
+    struct block {
+        std::vector<unsigned char> data; ///< Decoded bytes.
+        block_state state = queued;      ///< Decoding state.
+        bool prefetched = false;         ///< Whether it was queued for decoding ahead.
+        bool used = false;               ///< Whether a read has used it.
+    };
+
+    /**
+     * @brief Get the encoded size of a block.
+     */
+    size_t encoded_size(size_t index) const {
+        return std::min(RLE_READER_BLOCK, file.size - index * RLE_READER_BLOCK);
+    }
+
+    /**
+     * @brief Decode a block that the caller has claimed.
+     * 
+     * @param index Block index.
+     * @param target Block to fill.
+     */
+    void decode(size_t index, block& target) {
+        io_throttle.before_read(encoded_size(index));
+        target.data.resize(offsets[index + 1] - offsets[index]);
+        decode_rle_into(file.data + index * RLE_READER_BLOCK, encoded_size(index), target.data.data());
+
+        std::lock_guard<std::mutex> lock(mutex);
+        target.state = ready;
+        block_ready.notify_all();
+    }
+
+    /**
+     * @brief Get a decoded block, decoding it on this thread if no worker has started it.
+     * 
+     * @param index Block index.
+     * @return Decoded block.
+     */
+    std::shared_ptr<block> fetch(size_t index) {
+        std::unique_lock<std::mutex> lock(mutex);
+        std::shared_ptr<block> &slot = cache[index];
+        if (!slot) {
+            slot = std::make_shared<block>();
+            order.push_back(index);
+        }
+        std::shared_ptr<block> current = slot;
+        current->used = true;
+
+        if (current->state != ready && current->prefetched) {
+            window = std::min(window * 2, RLE_READER_MAX_WINDOW);
+        }
+        if (current->state == queued) {
+            current->state = decoding;
+            lock.unlock();
+            decode(index, *current);
+            lock.lock();
+        }
+        block_ready.wait(lock, [&] { return current->state == ready; });
+
+        evict();
+        return current;
+    }
+
+    /**
+     * @brief Drop the oldest finished blocks while the cache is over capacity.
+     * 
+     * The mutex must be held.
+     */
+    void evict() {
+        for (size_t checked = 0; cache.size() > RLE_READER_CACHE_BLOCKS && checked < order.size(); ++checked) {
+            size_t index = order.front();
+            order.pop_front();
+            std::shared_ptr<block> &candidate = cache[index];
+
+            if (candidate->state != ready) {
+                order.push_back(index);
+                continue;
+            }
+            if (candidate->prefetched && !candidate->used) {
+                window = std::max<size_t>(window / 2, 1);
+            }
+            cache.erase(index);
+        }
+    }
+
+    /**
+     * @brief Update sequential access detection and queue blocks ahead.
+     * 
+     * @param index Block about to be read.
+     */
+    void track_access(size_t index) {
+        std::lock_guard<std::mutex> lock(mutex);
+
+        if (index == last_block) {
+            return;
+        }
+        streak = (index == last_block + 1) ? streak + 1 : 0;
+        last_block = index;
+        if (streak < 2) {
+            return;
+        }
+
+        size_t blocks = offsets.size() - 1;
+        for (size_t ahead = index + 1; ahead <= index + window && ahead < blocks; ++ahead) {
+            std::shared_ptr<block> &slot = cache[ahead];
+            if (slot) {
+                continue;
+            }
+            slot = std::make_shared<block>();
+            slot->prefetched = true;
+            order.push_back(ahead);
+
+            std::shared_ptr<block> target = slot;
+            ++outstanding;
+            rle_default_scheduler().submit(RLE_JOB_BULK, [this, ahead, target] {
+                bool claimed = false;
+                {
+                    std::lock_guard<std::mutex> lock(mutex);
+                    if (target->state == queued) {
+                        target->state = decoding;
+                        claimed = true;
+                    }
+                }
+                if (claimed) {
+                    decode(ahead, *target);
+                }
+                --outstanding;
+            });
+        }
+    }
+
+    rle_mapped_file file;                                ///< Mapped encoded file.
+    bool well_formed = false;                            ///< Whether the file passed rle_validate().
+    std::vector<uint64_t> offsets;                       ///< Decoded offset of each block, plus the total size.
+    mutable std::mutex mutex;                            ///< Guards the cache and access tracking.
+    std::condition_variable block_ready;                 ///< Signals that a block finished decoding.
+    std::map<size_t, std::shared_ptr<block>> cache;      ///< Cached blocks by index.
+    std::deque<size_t> order;                            ///< Cached block indices, oldest first.
+    size_t last_block = SIZE_MAX;                        ///< Block of the previous read.
+    size_t streak = 0;                                   ///< Consecutive forward block steps.
+    size_t window = 1;                                   ///< Blocks to decode ahead.
+    std::atomic<size_t> outstanding{0};                  ///< Decode-ahead jobs not yet finished.
+};
+
+/**
+ * @brief Run-length compressed bitmap in the style of EWAH.
+ * 
+ * The bitmap is a sequence of 64 bit words stored as runs. Each run is a
+ * fill of identical all-zero or all-one words followed by a number of
+ * literal words. Set operations merge the run sequences of both operands,
+ * so fills are combined in constant time and only literal words are
+ * touched one by one. Bitmaps of different lengths are treated as padded
+ * with zero words.
+ */
+class rle_bitmap {
+public:
+    /**
+     * @brief Compress an uncompressed bitmap.
+     * 
+     * @param words Bitmap words, bit i of the bitmap is bit i % 64 of word i / 64.
+     * @return Compressed bitmap.
+     */
+    static rle_bitmap from_words(const std::vector<uint64_t>& words) {
+        rle_bitmap bitmap;
+        bitmap.append_literals(words.data(), words.size());
+        return bitmap;
+    }
+
+    /**
+     * @brief Decompress the bitmap.
+     * 
+     * @return Bitmap words.
+     */
+    std::vector<uint64_t> to_words() const {
+        std::vector<uint64_t> words;
+        const uint64_t *literal = literals.data();
+
+        for (const run &r : runs) {
+            words.insert(words.end(), r.fill_words, r.fill_bit ? ~uint64_t(0) : 0);
+            words.insert(words.end(), literal, literal + r.literal_words);
+            literal += r.literal_words;
+        }
+
+        return words;
+    }
+
+    /**
+     * @brief Append words that all have every bit set to the same value.
+     * 
+     * @param bit Value of the bits.
+     * @param count Number of words.
+     */
+    void append_fill(bool bit, uint64_t count) {
+        if (count == 0) {
+            return;
+        }
+        if (runs.empty() || runs.back().literal_words != 0 || runs.back().fill_bit != bit) {
+            if (!runs.empty() && runs.back().fill_words == 0 && runs.back().literal_words == 0) {
+                runs.back().fill_bit = bit;
+            } else {
+                runs.push_back({0, 0, bit});
+            }
+        }
+        runs.back().fill_words += count;
+        total_words += count;
+    }
+
+    /**
+     * @brief Append words, turning all-zero and all-one words into fills.
+     * 
+     * @param data Pointer to the words.
+     * @param count Number of words.
+     */
+    void append_literals(const uint64_t *data, size_t count) {
+        for (size_t i = 0; i < count;) {
+            if (data[i] == 0 || data[i] == ~uint64_t(0)) {
+                size_t end = i + 1;
+                while (end < count && data[end] == data[i]) {
+                    ++end;
+                }
+                append_fill(data[i] != 0, end - i);
+                i = end;
+                continue;
+            }
+
+            size_t end = i + 1;
+            while (end < count && data[end] != 0 && data[end] != ~uint64_t(0)) {
+                ++end;
+            }
+            if (runs.empty()) {
+                runs.push_back({0, 0, false});
+            }
+            literals.insert(literals.end(), data + i, data + end);
+            runs.back().literal_words += end - i;
+            total_words += end - i;
+            i = end;
+        }
+    }
+
+    /**
+     * @brief Count the set bits.
+     * 
+     * @return Number of set bits.
+     */
+    uint64_t popcount() const {
+        uint64_t total = 0;
+
+        for (const run &r : runs) {
+            if (r.fill_bit) {
+                total += 64 * r.fill_words;
+            }
+        }
+        for (uint64_t word : literals) {
+            total += __builtin_popcountll(word);
+        }
+
+        return total;
+    }
+
+    /**
+     * @brief Get the length of the bitmap.
+     * 
+     * @return Number of 64 bit words.
+     */
+    uint64_t word_count() const {
+        return total_words;
+    }
+
+    /**
+     * @brief Get the number of runs, which bounds the cost of set operations.
+     * 
+     * @return Number of runs.
+     */
+    size_t run_count() const {
+        return runs.size();
+    }
+
+    friend rle_bitmap bitmap_and(const rle_bitmap& a, const rle_bitmap& b);
+    friend rle_bitmap bitmap_or(const rle_bitmap& a, const rle_bitmap& b);
+    friend rle_bitmap bitmap_xor(const rle_bitmap& a, const rle_bitmap& b);
+    friend rle_bitmap bitmap_andnot(const rle_bitmap& a, const rle_bitmap& b);
+
+private:
+    /**
+     * @brief A fill followed by literal words.
+     */
+    struct run {
+        uint64_t fill_words;    ///< Number of fill words.
+        uint64_t literal_words; ///< Number of literal words after the fill.
+        bool fill_bit;          ///< Value of every bit in the fill.
+    };
+
+    /**
+     * @brief Read position in a bitmap, past its end it reads zero fill forever.
+     */
+    struct cursor {
+        const rle_bitmap &bitmap;  ///< Bitmap being read.
+        size_t run_index = 0;      ///< Current run.
+        uint64_t fill_left = 0;    ///< Fill words left in the current run.
+        uint64_t literal_left = 0; ///< Literal words left in the current run.
+        const uint64_t *literal;   ///< Next literal word.
+
+        explicit cursor(const rle_bitmap &bitmap) : bitmap(bitmap), literal(bitmap.literals.data()) {
+            load();
+        }
+
+        /**
+         * @brief Move to the next run with words left.
+         */
+        void load() {
+            while (fill_left == 0 && literal_left == 0 && run_index < bitmap.runs.size()) {
+                fill_left = bitmap.runs[run_index].fill_words;
+                literal_left = bitmap.runs[run_index].literal_words;
+                ++run_index;
+            }
+        }
+
+        bool done() const {
+            return fill_left == 0 && literal_left == 0;
+        }
+
+        bool in_fill() const {
+            return fill_left != 0 || done();
+        }
+
+        uint64_t fill_word() const {
+            return (!done() && bitmap.runs[run_index - 1].fill_bit) ? ~uint64_t(0) : 0;
+        }
+
+        /**
+         * @brief Number of words left in the current fill or literal group.
+         */
+        uint64_t available() const {
+            if (done()) {
+                return UINT64_MAX;
+            }
+            return fill_left != 0 ? fill_left : literal_left;
+        }
+
+        void skip(uint64_t count) {
+            if (fill_left != 0) {
+                fill_left -= count;
+            } else {
+                literal_left -= count;
+                literal += count;
+            }
+            load();
+        }
+    };
+
+    /**
+     * @brief Combine two bitmaps word by word by merging their runs.
+     * 
+     * @param a First operand.
+     * @param b Second operand.
+     * @param op Word operation, callable on uint64_t and, on SSE2 builds, __m128i.
+     * @return Resulting bitmap.
+     */
+    template <typename Op>
+    static rle_bitmap combine(const rle_bitmap& a, const rle_bitmap& b, Op op) {
+        rle_bitmap result;
+        cursor ca(a), cb(b);
+        uint64_t buffer[256];
+
+        while (!ca.done() || !cb.done()) {
+            uint64_t count = std::min(ca.available(), cb.available());
+
+            if (ca.in_fill() && cb.in_fill()) {
+                result.append_fill(op(ca.fill_word(), cb.fill_word()) != 0, count);
+            } else if (ca.in_fill() || cb.in_fill()) {
+                bool fill_first = ca.in_fill();
+                uint64_t fill = fill_first ? ca.fill_word() : cb.fill_word();
+                const uint64_t *literal = fill_first ? cb.literal : ca.literal;
+                uint64_t if_zero = fill_first ? op(fill, uint64_t(0)) : op(uint64_t(0), fill);
+                uint64_t if_ones = fill_first ? op(fill, ~uint64_t(0)) : op(~uint64_t(0), fill);
+
+                if (if_zero == if_ones) {
+                    result.append_fill(if_zero != 0, count);
+                } else if (if_zero == 0) {
+                    result.append_literals(literal, count);
+                } else {
+                    for (uint64_t done = 0; done < count; done += 256) {
+                        size_t n = std::min<uint64_t>(256, count - done);
+                        for (size_t i = 0; i < n; ++i) {
+                            buffer[i] = ~literal[done + i];
+                        }
+                        result.append_literals(buffer, n);
+                    }
+                }
+            } else {
+                for (uint64_t done = 0; done < count; done += 256) {
+                    size_t n = std::min<uint64_t>(256, count - done);
+                    combine_literals(ca.literal + done, cb.literal + done, buffer, n, op);
+                    result.append_literals(buffer, n);
+                }
+            }
+
+            ca.skip(ca.done() ? 0 : count);
+            cb.skip(cb.done() ? 0 : count);
+        }
+
+        return result;
+    }
+
+    /**
+     * @brief Combine two arrays of literal words, two words per SSE2 operation.
+     */
+    template <typename Op>
+    static void combine_literals(const uint64_t *a, const uint64_t *b, uint64_t *out, size_t count, Op op) {
+        size_t i = 0;
+#ifdef __SSE2__
+        for (; i + 2 <= count; i += 2) {
+            __m128i va = _mm_loadu_si128(reinterpret_cast<const __m128i *>(a + i));
+            __m128i vb = _mm_loadu_si128(reinterpret_cast<const __m128i *>(b + i));
+            _mm_storeu_si128(reinterpret_cast<__m128i *>(out + i), op(va, vb));
+        }
+#endif
+        for (; i < count; ++i) {
+            out[i] = op(a[i], b[i]);
+        }
+    }
+
+    std::vector<run> runs;          ///< Runs in bitmap order.
+    std::vector<uint64_t> literals; ///< Literal words of all runs, in order.
+    uint64_t total_words = 0;       ///< Length of the bitmap in words.
+};
+
+/**
+ * @brief Define a word operation functor for rle_bitmap::combine().
+ */
+#ifdef __SSE2__
+#define RLE_BITMAP_OP(name, scalar, vector) \
+    struct name { \
+        uint64_t operator()(uint64_t a, uint64_t b) const { return scalar; } \
+        __m128i operator()(__m128i a, __m128i b) const { return vector; } \
+    }
+#else
+#define RLE_BITMAP_OP(name, scalar, vector) \
+    struct name { \
+        uint64_t operator()(uint64_t a, uint64_t b) const { return scalar; } \
+    }
+#endif
+
+RLE_BITMAP_OP(rle_bitmap_and_op, a & b, _mm_and_si128(a, b));
+RLE_BITMAP_OP(rle_bitmap_or_op, a | b, _mm_or_si128(a, b));
+RLE_BITMAP_OP(rle_bitmap_xor_op, a ^ b, _mm_xor_si128(a, b));
+RLE_BITMAP_OP(rle_bitmap_andnot_op, a & ~b, _mm_andnot_si128(b, a));
+
+/**
+ * @brief Intersect two bitmaps.
+ * 
+ * @param a First bitmap.
+ * @param b Second bitmap.
+ * @return Bits set in both bitmaps.
+ */
+rle_bitmap bitmap_and(const rle_bitmap& a, const rle_bitmap& b) {
+    return rle_bitmap::combine(a, b, rle_bitmap_and_op());
+}
+
+/**
+ * @brief Unite two bitmaps.
+ * 
+ * @param a First bitmap.
+ * @param b Second bitmap.
+ * @return Bits set in either bitmap.
+ */
+rle_bitmap bitmap_or(const rle_bitmap& a, const rle_bitmap& b) {
+    return rle_bitmap::combine(a, b, rle_bitmap_or_op());
+}
+
+/**
+ * @brief Compute the symmetric difference of two bitmaps.
+ * 
+ * @param a First bitmap.
+ * @param b Second bitmap.
+ * @return Bits set in exactly one bitmap.
+ */
+rle_bitmap bitmap_xor(const rle_bitmap& a, const rle_bitmap& b) {
+    return rle_bitmap::combine(a, b, rle_bitmap_xor_op());
+}
+
+/**
+ * @brief Subtract one bitmap from another.
+ * 
+ * @param a Bitmap to subtract from.
+ * @param b Bitmap to subtract.
+ * @return Bits set in a but not in b.
+ */
+rle_bitmap bitmap_andnot(const rle_bitmap& a, const rle_bitmap& b) {
+    return rle_bitmap::combine(a, b, rle_bitmap_andnot_op());
+}
+
+/**
+ * @brief Get the length of a UTF-8 sequence from its lead byte.
+ * 
+ * @param lead First byte of the sequence.
+ * @return Sequence length in bytes, or 0 if lead is not a valid lead byte.
+ */
+size_t utf8_sequence_length(unsigned char lead) {
+    if (lead < 0x80) {
+        return 1;
+    } else if (lead >= 0xc2 && lead <= 0xdf) {
+        return 2;
+    } else if (lead >= 0xe0 && lead <= 0xef) {
+        return 3;
+    } else if (lead >= 0xf0 && lead <= 0xf4) {
+        return 4;
+    }
+    return 0;
+}
+
+/**
+ * @brief Check that a buffer holds valid UTF-8.
+ * 
+ * Runs of ASCII are skipped 16 bytes at a time with SSE2; multi-byte
+ * sequences are checked for truncation, overlong forms, surrogates and
+ * code points above U+10FFFF.
+ * 
+ * @param data Pointer to the bytes.
+ * @param size Number of bytes.
+ * @return True if the bytes are valid UTF-8.
+ */
+bool utf8_validate(const unsigned char *data, size_t size) {
+    size_t i = 0;
+
+    while (i < size) {
+#ifdef __SSE2__
+        while (i + 16 <= size &&
+               _mm_movemask_epi8(_mm_loadu_si128(reinterpret_cast<const __m128i *>(data + i))) == 0) {
+            i += 16;
+        }
+        if (i >= size) {
+            break;
+        }
+#endif
+        size_t length = utf8_sequence_length(data[i]);
+        if (length == 0 || i + length > size) {
+            return false;
+        }
+        for (size_t j = 1; j < length; ++j) {
+            if ((data[i + j] & 0xc0) != 0x80) {
+                return false;
+            }
+        }
+        if ((data[i] == 0xe0 && data[i + 1] < 0xa0) || (data[i] == 0xed && data[i + 1] > 0x9f) ||
+            (data[i] == 0xf0 && data[i + 1] < 0x90) || (data[i] == 0xf4 && data[i + 1] > 0x8f)) {
+            return false;
+        }
+        i += length;
+    }
+
+    return true;
+}
+
+/**
+ * @brief Encode UTF-8 text using RLE over code points.
+ * 
+ * Each pair is a count byte followed by the UTF-8 sequence of one code
+ * point, so repeated multi-byte characters form runs. For ASCII text the
+ * output is identical to encode_rle().
+ * 
+ * @param text Valid UTF-8 text.
+ * @return RLE encoded vector of bytes.
+ */
+std::vector<unsigned char> encode_rle_utf8(const std::string& text) {
+    const unsigned char *data = reinterpret_cast<const unsigned char *>(text.data());
+    std::vector<unsigned char> encoded;
+
+    for (size_t i = 0; i < text.size();) {
+        size_t length = std::max<size_t>(1, utf8_sequence_length(data[i]));
+        length = std::min(length, text.size() - i);
+
+        size_t count = 1;
+        while (count < RLE_MAX_RUN && i + (count + 1) * length <= text.size() &&
+               std::memcmp(data + i, data + i + count * length, length) == 0) {
+            ++count;
+        }
+
+        encoded.push_back(static_cast<unsigned char>(count));
+        encoded.insert(encoded.end(), data + i, data + i + length);
+        i += count * length;
+    }
+
+    return encoded;
+}
+
+/**
+ * @brief Decode text encoded by encode_rle_utf8().
+ * 
+ * @param encoded RLE encoded vector of bytes.
+ * @param text Decoded text, only valid if decoding succeeded.
+ * @return True if the input was well formed and decoded to valid UTF-8.
+ */
+bool decode_rle_utf8(const std::vector<unsigned char>& encoded, std::string& text) {
+    text.clear();
+
+    for (size_t i = 0; i < encoded.size();) {
+        if (i + 1 >= encoded.size()) {
+            return false;
+        }
+        size_t count = encoded[i];
+        size_t length = utf8_sequence_length(encoded[i + 1]);
+        if (length == 0 || i + 1 + length > encoded.size()) {
+            return false;
+        }
+
+        const char *symbol = reinterpret_cast<const char *>(&encoded[i + 1]);
+        for (size_t j = 0; j < count; ++j) {
+            text.append(symbol, length);
+        }
+        i += 1 + length;
+    }
+
+    return utf8_validate(reinterpret_cast<const unsigned char *>(text.data()), text.size());
+}
+
+/**
+ * @brief Encode input text using RLE and convert to hex string.
+ * 
+ * @param input Input text string.
+ * @return Hex string of the RLE encoded input text.
+ */
+std::string encode_rle_hex(const std::string& input) {
+    return bytes_to_hex(encode_rle_utf8(input));
+}
+
+/**
+ * @brief Decode RLE encoded text.
+ * 
+ * Falls back to byte-wise decoding for data produced before the code point
+ * mode existed.
+ * 
+ * @param encoded RLE encoded bytes.
+ * @param text Decoded text, only valid if decoding succeeded.
+ * @return True if the result is valid UTF-8.
+ */
+bool decode_rle_text(const std::vector<unsigned char>& encoded, std::string& text) {
+    if (decode_rle_utf8(encoded, text)) {
+        return true;
+    }
+
+    std::vector<unsigned char> decoded = decode_rle(encoded);
+    text.assign(decoded.begin(), decoded.end());
+    return utf8_validate(decoded.data(), decoded.size());
+}
+
+/**
+ * @brief Decode hex string from RLE encoding.
+ * 
+ * @param hex Hex string of RLE encoded data.
+ * @param text Decoded text, only valid if decoding succeeded.
+ * @return True if the input was valid hex and the result is valid UTF-8.
+ */
+bool decode_rle_hex(const std::string& hex, std::string& text) {
+    std::vector<unsigned char> encoded = hex_to_bytes(hex);
+    if (encoded.empty() && !hex.empty()) {
+        text.clear();
+        return false;
+    }
+    return decode_rle_text(encoded, text);
+}
+
+static const size_t RLE_HEX_INITIAL = 512;      ///< Encoded bytes rendered as hex when a result is shown.
+static const size_t RLE_HEX_CHUNK = 512;        ///< Encoded bytes rendered each time the cursor nears the end.
+static const size_t RLE_HEX_MARGIN = 256;       ///< Distance from the end, in characters, that renders more.
+static const size_t RLE_ENTRY_MAX_CHARS = 65535; ///< Most characters a GtkEntry can hold.
+
+/**
+ * @brief Render more of text_result as hex at the end of the text entry.
+ * 
+ * Rendering stops at the GtkEntry length limit; the remaining bytes are
+ * still used by decoding and copying.
+ * 
+ * @param entry Text entry showing text_result.
+ * @param bytes Number of encoded bytes to render.
+ */
+void render_text_result(GtkWidget *entry, size_t bytes) {
+    size_t limit = std::min(text_result.size(), RLE_ENTRY_MAX_CHARS / 2);
+    size_t count = std::min(bytes, limit - std::min(limit, text_result_rendered));
+    if (count == 0) {
+        return;
+    }
+
+    std::string hex(2 * count, '0');
+    bytes_to_hex_into(text_result.data() + text_result_rendered, count, &hex[0]);
+    gint position = 2 * text_result_rendered;
+
+    text_result_rendering = true;
+    gtk_editable_insert_text(GTK_EDITABLE(entry), hex.c_str(), hex.size(), &position);
+    text_result_rendering = false;
+    text_result_rendered += count;
+}
+
+/**
+ * @brief Callback for changes to the text entry, ending lazy rendering on user edits.
+ * 
+ * @param editable Text entry.
+ * @param user_data User data passed to the callback function.
+ */
+void on_text_entry_changed(GtkEditable *editable, gpointer user_data) {
+    if (!text_result_rendering) {
+        text_result_active = false;
+    }
+}
+
+/**
+ * @brief Callback for cursor and scroll changes, rendering more hex near the end.
+ * 
+ * @param object Text entry.
+ * @param pspec Property that changed.
+ * @param user_data User data passed to the callback function.
+ */
+void on_text_entry_scrolled(GObject *object, GParamSpec *pspec, gpointer user_data) {
+    if (text_result_active &&
+        gtk_editable_get_position(GTK_EDITABLE(object)) + RLE_HEX_MARGIN >= 2 * text_result_rendered) {
+        render_text_result(GTK_WIDGET(object), RLE_HEX_CHUNK);
+    }
+}
+
+/**
+ * @brief Callback for copying from the text entry.
+ * 
+ * When the selection reaches the end of a lazily rendered result, the
+ * clipboard receives the hex of the whole rest of the result, converted in
+ * chunks into one preallocated string.
+ * 
+ * @param entry Text entry.
+ * @param user_data User data passed to the callback function.
+ */
+void on_text_entry_copy(GtkEntry *entry, gpointer user_data) {
+    gint start, end;
+    if (!text_result_active || !gtk_editable_get_selection_bounds(GTK_EDITABLE(entry), &start, &end) ||
+        static_cast<size_t>(end) < 2 * text_result_rendered || text_result_rendered == text_result.size()) {
+        return;
+    }
+
+    size_t first = start / 2;
+    std::string hex(2 * (text_result.size() - first), '0');
+    for (size_t done = first; done < text_result.size(); done += RLE_HEX_CHUNK) {
+        size_t count = std::min(RLE_HEX_CHUNK, text_result.size() - done);
+        bytes_to_hex_into(text_result.data() + done, count, &hex[2 * (done - first)]);
+    }
+
+    gtk_clipboard_set_text(gtk_widget_get_clipboard(GTK_WIDGET(entry), GDK_SELECTION_CLIPBOARD),
+                           hex.c_str() + (start % 2), hex.size() - (start % 2));
+    g_signal_stop_emission_by_name(entry, "copy-clipboard");
+}
+
+/**
+ * @brief Callback function for the About button click event.
+ * 
+ * @param button GTK button that was clicked.
+ * @param user_data User data passed to the callback function.
+ */
+void on_about_clicked(GtkButton *button, gpointer user_data) {
+    GtkWidget *about_window = GTK_WIDGET(user_data);
+    gtk_widget_show_all(about_window);
+}
+
+/**
+ * @brief Perform text encoding or decoding action based on action type.
+ * 
+ * Encoding keeps the binary result in text_result and renders only its
+ * beginning as hex; decoding uses text_result directly while the entry is
+ * unmodified.
+ * 
+ * @param action_type Action type: 0 for encoding, 1 for decoding.
+ * @param text_entry_widget GTK text entry widget containing the text.
+ */
+void text_action(int action_type, GtkWidget *text_entry_widget) {
+    const gchar *text = gtk_entry_get_text(GTK_ENTRY(text_entry_widget));
+    std::string input_text = text;
+    std::string result_text;
+    bool valid = true;
+
+    if (action_type != 0 && action_type != 1) {
+        g_printerr("Invalid action type.\n");
+        return;
+    }
+
+    rle_default_scheduler().run(RLE_JOB_INTERACTIVE, [&] {
+        if (action_type == 0) {
+            text_result = encode_rle_utf8(input_text);
+        } else if (text_result_active) {
+            valid = decode_rle_text(text_result, result_text);
+        } else {
+            valid = decode_rle_hex(input_text, result_text);
+        }
+    });
+
+    if (!valid) {
+        g_printerr("Decoded text is not valid UTF-8.\n");
+        return;
+    }
+
+    if (action_type == 0) {
+        text_result_rendering = true;
+        gtk_entry_set_text(GTK_ENTRY(text_entry_widget), "");
+        text_result_rendering = false;
+        text_result_rendered = 0;
+        text_result_active = true;
+        render_text_result(text_entry_widget, RLE_HEX_INITIAL);
+    } else {
+        gtk_entry_set_text(GTK_ENTRY(text_entry_widget), result_text.c_str());
+    }
+}
+
+static const size_t RLE_FILE_CHUNK = 1 << 20; ///< Bytes read from a file at a time.
+
+/**
+ * @brief Show the decoded size and ratio of the file highlighted in a file chooser.
+ * 
+ * Only up to date sidecars are read, so highlighting a large file without
+ * one never scans it on the main thread.
+ * 
+ * @param chooser File chooser emitting "update-preview".
+ * @param user_data Preview label.
+ */
+void on_file_chooser_update_preview(GtkFileChooser *chooser, gpointer user_data) {
+    char *filename = gtk_file_chooser_get_preview_filename(chooser);
+    uint64_t encoded_size = 0, decoded_size = 0;
+    bool active = filename != NULL && rle_read_index(filename, encoded_size, decoded_size);
+
+    if (active) {
+        std::ostringstream text;
+        text << "Decoded: " << decoded_size << " bytes\nRatio: " << std::fixed << std::setprecision(2)
+             << (encoded_size ? static_cast<double>(decoded_size) / encoded_size : 0.0);
+        gtk_label_set_text(GTK_LABEL(user_data), text.str().c_str());
+    }
+    gtk_file_chooser_set_preview_widget_active(chooser, active);
+    g_free(filename);
+}
+
+/**
+ * @brief Perform file encoding or decoding action based on action type.
+ * 
+ * @param action_type Action type: 0 for encoding, 1 for decoding.
+ * @param parent_window Parent GTK window.
+ * @param action GTK file chooser action.
+ */
+void file_action(int action_type, GtkWidget *parent_window, GtkFileChooserAction action) {
+    GtkWidget *dialog;
+    gint res;
+
+    dialog = gtk_file_chooser_dialog_new(
+        (action_type == 0) ? "Encode file" : "Save File",
+        GTK_WINDOW(parent_window),
+        action,
+        "_Cancel",
+        GTK_RESPONSE_CANCEL,
+        (action_type == 0) ? "_Encode" : "_Decode",
+        GTK_RESPONSE_ACCEPT,
+        NULL
+    );
+
+    if (action_type == 1) {
+        GtkWidget *preview = gtk_label_new(NULL);
+        gtk_file_chooser_set_preview_widget(GTK_FILE_CHOOSER(dialog), preview);
+        g_signal_connect(dialog, "update-preview", G_CALLBACK(on_file_chooser_update_preview), preview);
+    }
+
+    res = gtk_dialog_run(GTK_DIALOG(dialog));
+    if (res == GTK_RESPONSE_ACCEPT) {
+        char *filename;
+        GtkFileChooser *chooser = GTK_FILE_CHOOSER(dialog);
+        filename = gtk_file_chooser_get_filename(chooser);
+
+        std::ifstream file_in(filename, std::ios::binary | std::ios::ate);
+        std::ofstream file_out;
+        std::string output_filename;
+
+        if (file_in.is_open()) {
+            std::streamsize size = file_in.tellg();
+            file_in.seekg(0, std::ios::beg);
+
+            if (action_type == 0) {
+                output_filename = std::string(filename) + ".encoded";
+                file_out.open(output_filename, std::ios::binary);
+                rle_stream_encoder encoder([&](const unsigned char *bytes, size_t count) {
+                    throttled_write(file_out, bytes, count);
+                });
+
+                std::vector<unsigned char> chunk(RLE_FILE_CHUNK);
+                uint64_t decoded_size = 0;
+                while (size_t count = throttled_read(file_in, chunk.data(), chunk.size())) {
+                    encoder.write(chunk.data(), count);
+                    decoded_size += count;
+                }
+                encoder.flush();
+                file_out.close();
+                rle_write_index(output_filename, decoded_size);
+            } else {
+                std::vector<unsigned char> data(size);
+                throttled_read(file_in, data.data(), size);
+                uint64_t decoded_size;
+                rle_validation result = rle_validate(data.data(), data.size(), rle_decode_limit, &decoded_size);
+
+                if (result == RLE_VALID) {
+                    std::vector<unsigned char> decoded = decode_rle(data);
+                    output_filename = std::string(filename) + ".decoded";
+                    file_out.open(output_filename, std::ios::binary);
+                    throttled_write(file_out, decoded.data(), decoded.size());
+                } else {
+                    g_printerr("%s\n", rle_validation_message(result));
+                }
+            }
+
+            file_out.close();
+        } else {
+            g_printerr("Failed to open file.\n");
+        }
+
+        g_free(filename);
+    }
+
+    gtk_widget_destroy(dialog);
+}
+
+/**
+ * @brief Callback function for the Encode button click event.
+ * 
+ * @param button GTK button that was clicked.
+ * @param user_data User data passed to the callback function.
+ */
+void on_encode_clicked(GtkButton *button, gpointer user_data) {
+    text_action(0, GTK_WIDGET(user_data));
+}
+
+/**
+ * @brief Callback function for the Decode button click event.
+ * 
+ * @param button GTK button that was clicked.
+ * @param user_data User data passed to the callback function.
+ */
+void on_decode_clicked(GtkButton *button, gpointer user_data) {
+    text_action(1, GTK_WIDGET(user_data));
+}
+
+/**
+ * @brief Callback function for the Encode File button click event.
+ * 
+ * @param button GTK button that was clicked.
+ * @param user_data User data passed to the callback function.
+ */
+void on_encode_file_clicked(GtkButton *button, gpointer user_data) {
+    file_action(0, GTK_WIDGET(user_data), GTK_FILE_CHOOSER_ACTION_SAVE);
+}
+
+/**
+ * @brief Callback function for the Decode File button click event.
+ * 
+ * @param button GTK button that was clicked.
+ * @param user_data User data passed to the callback function.
+ */
+void on_decode_file_clicked(GtkButton *button, gpointer user_data) {
+    file_action(1, GTK_WIDGET(user_data), GTK_FILE_CHOOSER_ACTION_SAVE);
+}
+
+/**
+ * @brief Benchmark encode_many() and decode_many() on synthetic messages.
+ * 
+ * Prints messages per second for the batched API next to a loop calling
+ * encode_rle() and decode_rle() once per message. While the batched API
+ * runs, a probe thread submits small interactive jobs and the scheduler's
+ * latency statistics are logged.
+ * 
+ * @param count Number of messages.
+ * @param size Size of each message in bytes.
+ * @return Exit status code.
+ */
+int bench_many(size_t count, size_t size) {
+    std::vector<unsigned char> source(count * size);
+    unsigned seed = 1;
+    for (size_t i = 0; i < source.size();) {
+        seed = seed * 1103515245 + 12345;
+        size_t run = 1 + (seed >> 16) % 8;
+        unsigned char byte = static_cast<unsigned char>(seed >> 24) & 0x0f;
+        for (; run > 0 && i < source.size(); --run) {
+            source[i++] = byte;
+        }
+    }
+
+    std::vector<rle_span> messages(count);
+    for (size_t i = 0; i < count; ++i) {
+        messages[i] = {source.data() + i * size, size};
+    }
+
+    auto seconds_since = [](std::chrono::steady_clock::time_point start) {
+        return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    };
+
+    auto start = std::chrono::steady_clock::now();
+    size_t single_bytes = 0;
+    for (size_t i = 0; i < count; ++i) {
+        std::vector<unsigned char> message(messages[i].data, messages[i].data + size);
+        single_bytes += decode_rle(encode_rle(message)).size();
+    }
+    double single = seconds_since(start);
+
+    rle_scheduler &scheduler = rle_default_scheduler();
+    scheduler.set_latency_target(RLE_JOB_INTERACTIVE, std::chrono::milliseconds(1));
+    std::atomic<bool> bulk_running(true);
+    std::thread prober([&] {
+        while (bulk_running) {
+            scheduler.run(RLE_JOB_INTERACTIVE, [&] {
+                decode_rle(encode_rle(std::vector<unsigned char>(source.begin(), source.begin() + std::min(size, source.size()))));
+            });
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+    });
+
+    start = std::chrono::steady_clock::now();
+    rle_batch encoded = encode_many(messages.data(), count);
+    double encode = seconds_since(start);
+
+    std::vector<rle_span> encoded_spans = rle_batch_spans(encoded);
+    start = std::chrono::steady_clock::now();
+    rle_batch decoded = decode_many(encoded_spans.data(), count);
+    double decode = seconds_since(start);
+
+    bulk_running = false;
+    prober.join();
+
+    if (decoded.arena != source || single_bytes != source.size()) {
+        g_printerr("Round trip mismatch.\n");
+        return 1;
+    }
+
+    g_print("%zu messages of %zu bytes, %u threads\n", count, size, rle_worker_count());
+    g_print("encode_rle + decode_rle: %.0f messages/s\n", count / single);
+    g_print("encode_many:             %.0f messages/s\n", count / encode);
+    g_print("decode_many:             %.0f messages/s\n", count / decode);
+    scheduler.log_latency();
+    return 0;
+}
+
+/**
+ * @brief Run the multi-sink pipeline from command-line options.
+ * 
+ * @param argc Argument count.
+ * @param argv Argument vector, starting with `--pipeline <input>`.
+ * @return Exit status code.
+ */
+int pipeline_command(int argc, char *argv[]) {
+    std::vector<rle_sink*> sinks;
+    std::ofstream encoded_out, hex_out;
+    std::string encoded_path;
+    std::unique_ptr<rle_encode_sink> encode_sink;
+    std::unique_ptr<rle_hash_sink> hash_sink;
+    std::unique_ptr<rle_histogram_sink> histogram_sink;
+    std::unique_ptr<rle_hex_sink> hex_sink;
+
+    for (int i = 3; i < argc; ++i) {
+        std::string option = argv[i];
+        if (option == "--encode" && i + 1 < argc) {
+            encoded_path = argv[++i];
+            encoded_out.open(encoded_path, std::ios::binary);
+            if (!encoded_out.is_open()) {
+                g_printerr("Failed to open file.\n");
+                return 1;
+            }
+            encode_sink.reset(new rle_encode_sink(encoded_out));
+            sinks.push_back(encode_sink.get());
+        } else if (option == "--hex" && i + 1 < argc) {
+            hex_out.open(argv[++i], std::ios::binary);
+            if (!hex_out.is_open()) {
+                g_printerr("Failed to open file.\n");
+                return 1;
+            }
+            hex_sink.reset(new rle_hex_sink(hex_out));
+            sinks.push_back(hex_sink.get());
+        } else if (option == "--hash") {
+            hash_sink.reset(new rle_hash_sink());
+            sinks.push_back(hash_sink.get());
+        } else if (option == "--histogram") {
+            histogram_sink.reset(new rle_histogram_sink());
+            sinks.push_back(histogram_sink.get());
+        } else {
+            g_printerr("Unknown pipeline option: %s\n", option.c_str());
+            return 1;
+        }
+    }
+
+    if (!rle_pipeline_run(argv[2], sinks)) {
+        return 1;
+    }
+
+    if (encode_sink) {
+        encoded_out.close();
+    }
+    if (hex_sink) {
+        hex_out.close();
+    }
+    if ((encode_sink && !encoded_out.good()) || (hex_sink && !hex_out.good())) {
+        g_printerr("Failed to write output file.\n");
+        return 1;
+    }
+    if (encode_sink) {
+        rle_write_index(encoded_path, encode_sink->decoded_bytes);
+    }
+
+    if (hash_sink) {
+        g_print("sha256 %s\n", hash_sink->digest.c_str());
+    }
+    if (histogram_sink) {
+        g_print("runs %llu\n", static_cast<unsigned long long>(histogram_sink->runs));
+        for (int b = 0; b < 64; ++b) {
+            if (histogram_sink->buckets[b] != 0) {
+                g_print("  %llu-%llu: %llu\n", 1ULL << b, (2ULL << b) - 1,
+                        static_cast<unsigned long long>(histogram_sink->buckets[b]));
+            }
+        }
+    }
+    return 0;
+}
+
+/**
+ * @brief Codec mode compared by the report tool.
+ */
+struct rle_mode {
+    const char *name;                                                                    ///< Mode name.
+    std::vector<unsigned char> (*encode)(const std::vector<unsigned char>&);             ///< Encoder.
+    bool (*decode)(const std::vector<unsigned char>&, std::vector<unsigned char>&);      ///< Decoder, false on failure.
+};
+
+/**
+ * @brief Decode byte-wise RLE for the report tool.
+ */
+static bool report_decode_rle(const std::vector<unsigned char>& encoded, std::vector<unsigned char>& decoded) {
+    decoded = decode_rle(encoded);
+    return true;
+}
+
+/**
+ * @brief Encode with the code point mode for the report tool.
+ */
+static std::vector<unsigned char> report_encode_utf8(const std::vector<unsigned char>& data) {
+    return encode_rle_utf8(std::string(data.begin(), data.end()));
+}
+
+/**
+ * @brief Decode the code point mode for the report tool.
+ */
+static bool report_decode_utf8(const std::vector<unsigned char>& encoded, std::vector<unsigned char>& decoded) {
+    std::string text;
+    bool valid = decode_rle_utf8(encoded, text);
+    decoded.assign(text.begin(), text.end());
+    return valid;
+}
+
+static const rle_mode rle_modes[] = {
+    {"rle", encode_rle, report_decode_rle},
+    {"rle-utf8", report_encode_utf8, report_decode_utf8},
+}; ///< Modes compared by the report tool.
+
+/**
+ * @brief Totals of one mode over the files of one type.
+ */
+struct rle_report_row {
+    std::string type;          ///< File type, the extension of the files.
+    const char *mode;          ///< Mode name.
+    size_t files = 0;          ///< Files measured.
+    size_t failed = 0;         ///< Files that did not round trip.
+    uint64_t bytes = 0;        ///< Input bytes.
+    uint64_t encoded = 0;      ///< Encoded bytes.
+    double encode_seconds = 0; ///< Total encode time.
+    double decode_seconds = 0; ///< Total decode time.
+    uint64_t peak_bytes = 0;   ///< Largest input, encoded and decoded buffers held at once.
+    bool pareto = false;       ///< Whether no other mode of the type is at least as good in every metric.
+
+    double ratio() const { return encoded ? static_cast<double>(bytes) / encoded : 0; }
+    double encode_rate() const { return encode_seconds > 0 ? bytes / encode_seconds / 1e6 : 0; }
+    double decode_rate() const { return decode_seconds > 0 ? bytes / decode_seconds / 1e6 : 0; }
+};
+
+/**
+ * @brief Collect the regular files under a directory.
+ * 
+ * @param dir Directory to search.
+ * @param files Paths found, appended.
+ */
+void collect_files(const std::string& dir, std::vector<std::string>& files) {
+    DIR *handle = opendir(dir.c_str());
+    if (handle == NULL) {
+        return;
+    }
+
+    while (struct dirent *entry = readdir(handle)) {
+        std::string name = entry->d_name;
+        if (name == "." || name == "..") {
+            continue;
+        }
+        std::string path = dir + "/" + name;
+        struct stat info;
+        if (stat(path.c_str(), &info) != 0) {
+            continue;
+        }
+        if (S_ISDIR(info.st_mode)) {
+            collect_files(path, files);
+        } else if (S_ISREG(info.st_mode)) {
+            files.push_back(path);
+        }
+    }
+    closedir(handle);
+}
+
+/**
+ * @brief Measure every mode on every file of a corpus and print a report.
+ * 
+ * Each file is encoded and decoded three times per mode and the fastest
+ * time is kept. Results are totalled per file extension, and the modes
+ * on the ratio/encode speed/decode speed Pareto frontier of each type are
+ * marked. Peak memory is the largest sum of input, encoded and decoded
+ * buffer sizes seen for a single file.
+ * 
+ * @param dir Corpus directory.
+ * @return Exit status code.
+ */
+int report_command(const std::string& dir) {
+    std::vector<std::string> files;
+    collect_files(dir, files);
+    if (files.empty()) {
+        g_printerr("No files found.\n");
+        return 1;
+    }
+
+    std::map<std::string, std::vector<rle_report_row>> rows;
+    for (const std::string& path : files) {
+        size_t slash = path.find_last_of('/');
+        size_t dot = path.find_last_of('.');
+        std::string type = (dot != std::string::npos && dot > slash + 1) ? path.substr(dot) : "(none)";
+
+        std::ifstream file_in(path, std::ios::binary);
+        std::vector<unsigned char> data((std::istreambuf_iterator<char>(file_in)), std::istreambuf_iterator<char>());
+        std::vector<rle_report_row> &type_rows = rows[type];
+        if (type_rows.empty()) {
+            for (const rle_mode& mode : rle_modes) {
+                type_rows.push_back(rle_report_row());
+                type_rows.back().type = type;
+                type_rows.back().mode = mode.name;
+            }
+        }
+
+        for (size_t m = 0; m < sizeof(rle_modes) / sizeof(rle_modes[0]); ++m) {
+            rle_report_row &row = type_rows[m];
+            std::vector<unsigned char> encoded, decoded;
+            double encode_best = 0, decode_best = 0;
+            bool valid = true;
+
+            for (int rep = 0; rep < 3; ++rep) {
+                auto start = std::chrono::steady_clock::now();
+                encoded = rle_modes[m].encode(data);
+                auto middle = std::chrono::steady_clock::now();
+                valid = rle_modes[m].decode(encoded, decoded);
+                auto end = std::chrono::steady_clock::now();
+                valid = valid && decoded == data;
+
+                double encode_time = std::chrono::duration<double>(middle - start).count();
+                double decode_time = std::chrono::duration<double>(end - middle).count();
+                encode_best = (rep == 0) ? encode_time : std::min(encode_best, encode_time);
+                decode_best = (rep == 0) ? decode_time : std::min(decode_best, decode_time);
+            }
+
+            if (!valid) {
+                ++row.failed;
+                continue;
+            }
+            ++row.files;
+            row.bytes += data.size();
+            row.encoded += encoded.size();
+            row.encode_seconds += encode_best;
+            row.decode_seconds += decode_best;
+            row.peak_bytes = std::max<uint64_t>(row.peak_bytes, data.size() + encoded.size() + decoded.size());
+        }
+    }
+
+    g_print("%-10s %-10s %6s %6s %10s %8s %10s %10s %9s %s\n",
+            "type", "mode", "files", "failed", "MiB", "ratio", "enc MB/s", "dec MB/s", "peak MiB", "pareto");
+    for (auto &entry : rows) {
+        std::vector<rle_report_row> &type_rows = entry.second;
+
+        for (rle_report_row &row : type_rows) {
+            row.pareto = row.files != 0;
+            for (const rle_report_row &other : type_rows) {
+                if (&other == &row || other.files == 0) {
+                    continue;
+                }
+                bool no_worse = other.ratio() >= row.ratio() && other.encode_rate() >= row.encode_rate() &&
+                                other.decode_rate() >= row.decode_rate();
+                bool better = other.ratio() > row.ratio() || other.encode_rate() > row.encode_rate() ||
+                              other.decode_rate() > row.decode_rate();
+                if (no_worse && better) {
+                    row.pareto = false;
+                }
+            }
+        }
+
+        for (const rle_report_row &row : type_rows) {
+            g_print("%-10s %-10s %6zu %6zu %10.2f %8.3f %10.1f %10.1f %9.2f %s\n",
+                    row.type.c_str(), row.mode, row.files, row.failed, row.bytes / 1048576.0, row.ratio(),
+                    row.encode_rate(), row.decode_rate(), row.peak_bytes / 1048576.0, row.pareto ? "*" : "");
+        }
+    }
+
+    return 0;
+}
+
+/**
+ * @brief List the encoded files under a directory with their decoded sizes and ratios.
+ * 
+ * Sizes come from the ".meta" sidecars where they are up to date, so
+ * usually only a few bytes are read per file. Files are looked up in
+ * parallel.
+ * 
+ * @param dir Directory to list.
+ * @return Exit status code.
+ */
+int ls_command(const std::string& dir) {
+    static const std::string suffix = ".encoded";
+    std::vector<std::string> files;
+    collect_files(dir, files);
+    files.erase(std::remove_if(files.begin(), files.end(), [](const std::string& path) {
+        return path.size() < suffix.size() || path.compare(path.size() - suffix.size(), suffix.size(), suffix) != 0;
+    }), files.end());
+    std::sort(files.begin(), files.end());
+
+    std::vector<uint64_t> encoded_sizes(files.size()), decoded_sizes(files.size());
+    std::vector<rle_index_source> sources(files.size());
+    parallel_for(files.size(), 16, [&](size_t begin, size_t end) {
+        for (size_t i = begin; i < end; ++i) {
+            sources[i] = rle_lookup_decoded_size(files[i], encoded_sizes[i], decoded_sizes[i]);
+        }
+    });
+
+    static const char *source_names[] = {"index", "scan", "invalid"};
+    g_print("%14s %14s %8s %-7s %s\n", "encoded", "decoded", "ratio", "source", "file");
+    for (size_t i = 0; i < files.size(); ++i) {
+        if (sources[i] == RLE_INDEX_INVALID) {
+            g_print("%14llu %14s %8s %-7s %s\n", static_cast<unsigned long long>(encoded_sizes[i]), "-", "-",
+                    source_names[sources[i]], files[i].c_str());
+            continue;
+        }
+        double ratio = encoded_sizes[i] ? static_cast<double>(decoded_sizes[i]) / encoded_sizes[i] : 0;
+        g_print("%14llu %14llu %8.2f %-7s %s\n", static_cast<unsigned long long>(encoded_sizes[i]),
+                static_cast<unsigned long long>(decoded_sizes[i]), ratio, source_names[sources[i]], files[i].c_str());
+    }
+    return 0;
+}
+
+/**
+ * @brief Cut a buffer into iovec fragments of a fixed size.
+ * 
+ * @param data Buffer.
+ * @param size Buffer size.
+ * @param fragment Fragment size.
+ * @return Fragments covering the buffer in order.
+ */
+std::vector<struct iovec> split_iov(const unsigned char *data, size_t size, size_t fragment) {
+    std::vector<struct iovec> fragments;
+    for (size_t offset = 0; offset < size; offset += fragment) {
+        fragments.push_back({const_cast<unsigned char *>(data) + offset, std::min(fragment, size - offset)});
+    }
+    return fragments;
+}
+
+/**
+ * @brief Round trip a file through encode_rle_iov() and decode_rle_iov() with fragmented buffers.
+ * 
+ * The input, encoded and decoded buffers are all cut into fragments of the
+ * given size, so runs and pairs straddle fragment boundaries. The results
+ * are compared with encode_rle(), and the -1 returns for too small outputs
+ * and for input ending with an unpaired byte are checked.
+ * 
+ * @param path File to round trip.
+ * @param fragment Fragment size in bytes.
+ * @return Exit status code, 0 if every check passed.
+ */
+int iov_command(const char *path, size_t fragment) {
+    rle_mapped_file file(path);
+    if (!file.valid || fragment == 0) {
+        g_printerr("Failed to open file.\n");
+        return 1;
+    }
+    io_throttle.before_read(file.size);
+
+    std::vector<unsigned char> data(file.data, file.data + file.size);
+    std::vector<unsigned char> expected = encode_rle(data);
+    std::vector<unsigned char> encoded(expected.size()), decoded(data.size());
+    std::vector<struct iovec> data_iov = split_iov(data.data(), data.size(), fragment);
+    std::vector<struct iovec> encoded_iov = split_iov(encoded.data(), encoded.size(), fragment);
+    std::vector<struct iovec> decoded_iov = split_iov(decoded.data(), decoded.size(), fragment);
+
+    ssize_t encoded_size = encode_rle_iov(data_iov.data(), data_iov.size(), encoded_iov.data(), encoded_iov.size());
+    bool encode_ok = encoded_size == static_cast<ssize_t>(expected.size()) && encoded == expected;
+    ssize_t decoded_size = decode_rle_iov(encoded_iov.data(), encoded_iov.size(), decoded_iov.data(), decoded_iov.size());
+    bool decode_ok = decoded_size == static_cast<ssize_t>(data.size()) && decoded == data;
+
+    bool overflow_ok = true;
+    if (!encoded_iov.empty()) {
+        struct iovec last = encoded_iov.back();
+        --encoded_iov.back().iov_len;
+        overflow_ok = encode_rle_iov(data_iov.data(), data_iov.size(), encoded_iov.data(), encoded_iov.size()) == -1 &&
+                      decode_rle_iov(encoded_iov.data(), encoded_iov.size(), decoded_iov.data(), decoded_iov.size()) == -1;
+        encoded_iov.back() = last;
+        --decoded_iov.back().iov_len;
+        overflow_ok = overflow_ok &&
+                      decode_rle_iov(encoded_iov.data(), encoded_iov.size(), decoded_iov.data(), decoded_iov.size()) == -1;
+    }
+
+    g_print("fragments: %zu input, %zu encoded, %zu decoded of %zu bytes\n",
+            data_iov.size(), encoded_iov.size(), decoded_iov.size(), fragment);
+    g_print("encode: %lld bytes, %s\n", static_cast<long long>(encoded_size), encode_ok ? "matches encode_rle" : "MISMATCH");
+    g_print("decode: %lld bytes, %s\n", static_cast<long long>(decoded_size), decode_ok ? "matches input" : "MISMATCH");
+    g_print("short output and unpaired input: %s\n", overflow_ok ? "rejected" : "NOT REJECTED");
+    return (encode_ok && decode_ok && overflow_ok) ? 0 : 1;
+}
+
+/**
+ * @brief Read a file of 64-bit words into a compressed bitmap.
+ * 
+ * A trailing partial word is padded with zero bits.
+ * 
+ * @param path File of words in host byte order.
+ * @param bitmap Bitmap read.
+ * @return True if the file could be read.
+ */
+bool read_bitmap_file(const std::string& path, rle_bitmap& bitmap) {
+    rle_mapped_file file(path);
+    if (!file.valid) {
+        return false;
+    }
+
+    std::vector<uint64_t> words((file.size + sizeof(uint64_t) - 1) / sizeof(uint64_t));
+    io_throttle.before_read(file.size);
+    if (file.size != 0) {
+        std::memcpy(words.data(), file.data, file.size);
+    }
+    bitmap = rle_bitmap::from_words(words);
+    return true;
+}
+
+/**
+ * @brief Combine two bitmap files and print the sizes and popcounts involved.
+ * 
+ * @param op Operation: and, or, xor or andnot.
+ * @param a_path First bitmap, a file of 64-bit words.
+ * @param b_path Second bitmap.
+ * @param output_path File receiving the result words, or NULL to only print.
+ * @return Exit status code.
+ */
+int bitmap_command(const std::string& op, const char *a_path, const char *b_path, const char *output_path) {
+    static const struct {
+        const char *name;
+        rle_bitmap (*apply)(const rle_bitmap&, const rle_bitmap&);
+    } ops[] = {
+        {"and", bitmap_and},
+        {"or", bitmap_or},
+        {"xor", bitmap_xor},
+        {"andnot", bitmap_andnot},
+    };
+
+    rle_bitmap (*apply)(const rle_bitmap&, const rle_bitmap&) = NULL;
+    for (const auto& entry : ops) {
+        if (op == entry.name) {
+            apply = entry.apply;
+        }
+    }
+    if (apply == NULL) {
+        g_printerr("Unknown bitmap operation: %s\n", op.c_str());
+        return 1;
+    }
+
+    rle_bitmap a, b;
+    if (!read_bitmap_file(a_path, a) || !read_bitmap_file(b_path, b)) {
+        g_printerr("Failed to open file.\n");
+        return 1;
+    }
+
+    rle_bitmap result = apply(a, b);
+    const rle_bitmap *bitmaps[] = {&a, &b, &result};
+    const char *names[] = {"a", "b", op.c_str()};
+    for (int i = 0; i < 3; ++i) {
+        g_print("%-8s words %12llu runs %10zu popcount %14llu\n", names[i],
+                static_cast<unsigned long long>(bitmaps[i]->word_count()), bitmaps[i]->run_count(),
+                static_cast<unsigned long long>(bitmaps[i]->popcount()));
+    }
+
+    if (output_path != NULL) {
+        std::ofstream file_out(output_path, std::ios::binary | std::ios::trunc);
+        std::vector<uint64_t> words = result.to_words();
+        throttled_write(file_out, words.data(), words.size() * sizeof(uint64_t));
+        if (!file_out.good()) {
+            g_printerr("Failed to write output file.\n");
+            return 1;
+        }
+    }
+    return 0;
+}
+
+/**
+ * @brief Write a range of a decoded file to standard output through rle_block_reader.
+ * 
+ * @param path Encoded file.
+ * @param offset Offset in the decoded data.
+ * @param length Number of bytes, or UINT64_MAX for the rest of the file.
+ * @return Exit status code.
+ */
+int read_command(const char *path, uint64_t offset, uint64_t length) {
+    rle_block_reader reader(path);
+    if (!reader.valid()) {
+        g_printerr("Failed to read encoded file.\n");
+        return 1;
+    }
+
+    std::vector<unsigned char> buffer(1 << 16);
+    while (length > 0) {
+        size_t count = reader.read(offset, buffer.data(), std::min<uint64_t>(length, buffer.size()));
+        if (count == 0) {
+            break;
+        }
+        throttled_write(std::cout, buffer.data(), count);
+        offset += count;
+        length -= count;
+    }
+
+    return std::cout.good() ? 0 : 1;
+}
+
+/**
+ * @brief Parse a size with an optional K, M or G suffix.
+ * 
+ * @param text Text to parse.
+ * @return Parsed value.
+ */
+double parse_size(const char *text) {
+    char *end;
+    double value = std::strtod(text, &end);
+
+    switch (*end) {
+    case 'K': case 'k': return value * 1024;
+    case 'M': case 'm': return value * 1024 * 1024;
+    case 'G': case 'g': return value * 1024 * 1024 * 1024;
+    default: return value;
+    }
+}
+
+/**
+ * @brief Apply global limit options and remove them from the arguments.
+ * 
+ * Recognized options, accepted anywhere on the command line and also
+ * applying to the GUI:
+ * - `--max-decoded <bytes>` sets rle_decode_limit, with K, M or G suffix.
+ * - `--limit-read <bytes/s>` and `--limit-write <bytes/s>`, with K, M or G suffix.
+ * - `--limit-read-iops <ops/s>` and `--limit-write-iops <ops/s>`.
+ * - `--idle-io` to use the idle I/O scheduling class.
+ * 
+ * @param argc Argument count, updated.
+ * @param argv Argument vector, updated.
+ */
+void parse_global_options(int *argc, char *argv[]) {
+    rle_io_limits limits;
+    int kept = 1;
+
+    for (int i = 1; i < *argc; ++i) {
+        std::string option = argv[i];
+        bool has_value = i + 1 < *argc;
+
+        if (option == "--limit-read" && has_value) {
+            limits.read_bytes_per_second = parse_size(argv[++i]);
+        } else if (option == "--limit-write" && has_value) {
+            limits.write_bytes_per_second = parse_size(argv[++i]);
+        } else if (option == "--limit-read-iops" && has_value) {
+            limits.reads_per_second = parse_size(argv[++i]);
+        } else if (option == "--limit-write-iops" && has_value) {
+            limits.writes_per_second = parse_size(argv[++i]);
+        } else if (option == "--max-decoded" && has_value) {
+            rle_decode_limit = static_cast<uint64_t>(parse_size(argv[++i]));
+        } else if (option == "--idle-io") {
+            limits.idle_priority = true;
+        } else {
+            argv[kept++] = argv[i];
+        }
+    }
+
+    *argc = kept;
+    argv[kept] = NULL;
+    io_throttle.configure(limits);
+}
+
+/**
+ * @brief Encode standard input to standard output as data arrives.
+ * 
+ * Input is encoded as soon as it is read, and held runs are flushed under
+ * the policy given by `--flush-bytes` and `--flush-ms`. Waiting for input
+ * times out when the oldest held byte reaches its hold limit, so a quiet
+ * producer does not delay output beyond it.
+ * 
+ * @param argc Argument count.
+ * @param argv Argument vector, starting with `--stream-encode`.
+ * @return Exit status code.
+ */
+int stream_encode_command(int argc, char *argv[]) {
+    rle_flush_policy policy;
+    for (int i = 2; i < argc; ++i) {
+        std::string option = argv[i];
+        if (option == "--flush-bytes" && i + 1 < argc) {
+            policy.max_held_bytes = static_cast<size_t>(parse_size(argv[++i]));
+        } else if (option == "--flush-ms" && i + 1 < argc) {
+            policy.max_hold_time = std::chrono::milliseconds(std::strtoull(argv[++i], NULL, 10));
+        } else {
+            g_printerr("Unknown stream option: %s\n", option.c_str());
+            return 1;
+        }
+    }
+
+    bool ok = true;
+    rle_stream_encoder encoder([&ok](const unsigned char *bytes, size_t count) {
+        io_throttle.before_write(count);
+        while (ok && count > 0) {
+            ssize_t written = write(STDOUT_FILENO, bytes, count);
+            if (written < 0 && errno != EINTR) {
+                ok = false;
+            } else if (written > 0) {
+                bytes += written;
+                count -= written;
+            }
+        }
+    }, policy);
+
+    std::vector<unsigned char> chunk(RLE_FILE_CHUNK);
+    while (ok) {
+        struct pollfd input = {STDIN_FILENO, POLLIN, 0};
+        long long delay = encoder.flush_delay();
+        int ready = ::poll(&input, 1, static_cast<int>(std::min<long long>(delay, INT32_MAX)));
+        if (ready < 0 && errno != EINTR) {
+            ok = false;
+        } else if (ready > 0) {
+            ssize_t count = read(STDIN_FILENO, chunk.data(), chunk.size());
+            if (count == 0) {
+                break;
+            }
+            if (count < 0 && errno != EINTR) {
+                ok = false;
+            } else if (count > 0) {
+                io_throttle.before_read(count);
+                encoder.write(chunk.data(), count);
+            }
+        }
+        encoder.poll();
+    }
+    encoder.flush();
+
+    if (!ok) {
+        g_printerr("Stream encoding failed.\n");
+        return 1;
+    }
+    return 0;
+}
+
+/**
+ * @brief Run a command-line subcommand instead of the GUI.
+ * 
+ * Supported subcommands:
+ * - `--bench-many [count] [size]` benchmarks the batched message API.
+ * - `--encode-delta <input> <base> <output>` encodes a file against a base file.
+ * - `--decode-delta <input> <base> <output>` reverses `--encode-delta`.
+ * - `--pipeline <input> [--encode <output>] [--hash] [--histogram] [--hex <output>]`
+ *   reads a file once and feeds every selected sink.
+ * - `--armor <input> <output> [hex|base64]` writes an encoded file as text lines; `--dearmor` reverses it.
+ * - `--bitmap <and|or|xor|andnot> <a> <b> [output]` combines two bitmap files of 64-bit words.
+ * - `--iov <file> [fragment]` round trips a file through the iovec encoder and decoder.
+ * - `--stream-encode [--flush-bytes <size>] [--flush-ms <ms>]` encodes standard input to standard output as it arrives.
+ * - `--ls <dir>` lists the encoded files under a directory with their decoded sizes.
+ * - `--read <encoded> [offset] [length]` writes decoded bytes to standard output.
+ * - `--report <dir>` compares every mode on a corpus directory.
+ * - `--shard-encode <input> <output> [shards]` encodes one file with several processes.
+ * - `--elf-encode <input> <output>` and `--elf-decode <input> <output>` handle ELF files segment by segment.
+ * - `--elf-list <archive>` and `--elf-extract <archive> <segment> <output>` inspect and extract single segments.
+ * - `--tar-encode <input> <output>` and `--tar-decode <input> <output>` handle tar streams member by member; "-" is a standard stream.
+ * 
+ * @param argc Argument count.
+ * @param argv Argument vector.
+ * @return Exit status code, or -1 if argv does not name a subcommand.
+ */
+int run_command_line(int argc, char *argv[]) {
+    if (argc < 2) {
+        return -1;
+    }
+
+    std::string command = argv[1];
+    if (command == "--bench-many") {
+        size_t count = (argc > 2) ? std::strtoull(argv[2], NULL, 10) : 1000000;
+        size_t size = (argc > 3) ? std::strtoull(argv[3], NULL, 10) : 64;
+        return bench_many(count, size);
+    }
+    if (command == "--encode-delta" && argc == 5) {
+        return encode_rle_delta_file(argv[2], argv[3], argv[4]) ? 0 : 1;
+    }
+    if (command == "--decode-delta" && argc == 5) {
+        return decode_rle_delta_file(argv[2], argv[3], argv[4]) ? 0 : 1;
+    }
+    if (command == "--pipeline" && argc >= 3) {
+        return pipeline_command(argc, argv);
+    }
+    if ((command == "--armor" || command == "--dearmor") && (argc == 4 || argc == 5)) {
+        const rle_armor *armor = find_rle_armor((argc == 5) ? argv[4] : "hex");
+        if (armor == NULL) {
+            g_printerr("Unknown armoring: %s\n", argv[4]);
+            return 1;
+        }
+        bool ok = (command == "--armor") ? encode_rle_armored(argv[2], argv[3], *armor)
+                                         : decode_rle_armored(argv[2], argv[3], *armor);
+        return ok ? 0 : 1;
+    }
+    if (command == "--bitmap" && (argc == 5 || argc == 6)) {
+        return bitmap_command(argv[2], argv[3], argv[4], (argc == 6) ? argv[5] : NULL);
+    }
+    if (command == "--iov" && (argc == 3 || argc == 4)) {
+        return iov_command(argv[2], (argc == 4) ? std::strtoull(argv[3], NULL, 10) : 4093);
+    }
+    if (command == "--stream-encode") {
+        return stream_encode_command(argc, argv);
+    }
+    if (command == "--ls" && argc == 3) {
+        return ls_command(argv[2]);
+    }
+    if (command == "--read" && argc >= 3) {
+        uint64_t offset = (argc > 3) ? std::strtoull(argv[3], NULL, 10) : 0;
+        uint64_t length = (argc > 4) ? std::strtoull(argv[4], NULL, 10) : UINT64_MAX;
+        return read_command(argv[2], offset, length);
+    }
+    if (command == "--report" && argc == 3) {
+        return report_command(argv[2]);
+    }
+    if (command == "--shard-encode" && argc >= 4) {
+        unsigned shards = (argc > 4) ? std::strtoul(argv[4], NULL, 10) : rle_worker_count();
+        return encode_rle_sharded(argv[2], argv[3], shards, 2) ? 0 : 1;
+    }
+    if (command == "--elf-encode" && argc == 4) {
+        return encode_rle_elf(argv[2], argv[3]) ? 0 : 1;
+    }
+    if (command == "--elf-decode" && argc == 4) {
+        return decode_rle_elf(argv[2], argv[3]) ? 0 : 1;
+    }
+    if ((command == "--tar-encode" || command == "--tar-decode") && argc == 4) {
+        return tar_command(command == "--tar-encode", argv[2], argv[3]);
+    }
+    if (command == "--elf-list" && argc == 3) {
+        return list_rle_elf(argv[2]);
+    }
+    if (command == "--elf-extract" && argc == 5) {
+        return decode_rle_elf_segment(argv[2], std::strtoll(argv[3], NULL, 10), argv[4]) ? 0 : 1;
+    }
+
+    return -1;
+}
+
+/**
+ * @brief Main function to initialize the GTK application and run the main loop.
+ * 
+ * @param argc Argument count.
+ * @param argv Argument vector.
+ * @return Exit status code.
+ */
+int main(int argc, char *argv[]) {
+    parse_global_options(&argc, argv);
+
+    int status = run_command_line(argc, argv);
+    if (status >= 0) {
+        return status;
+    }
+
     gtk_init(&argc, &argv);
 
     builder = gtk_builder_new_from_file("gui.glade");
@@ -289,8 +5352,13 @@ int main(int argc, char *argv[]) {
     g_signal_connect(gtk_builder_get_object(builder, "decode_button"), "clicked", G_CALLBACK(on_decode_clicked), text_entry);
     g_signal_connect(gtk_builder_get_object(builder, "encode_file_button"), "clicked", G_CALLBACK(on_encode_file_clicked), about_window);
     g_signal_connect(gtk_builder_get_object(builder, "decode_file_button"), "clicked", G_CALLBACK(on_decode_file_clicked), about_window);
+    g_signal_connect(text_entry, "changed", G_CALLBACK(on_text_entry_changed), NULL);
+    g_signal_connect(text_entry, "notify::cursor-position", G_CALLBACK(on_text_entry_scrolled), NULL);
+    g_signal_connect(text_entry, "notify::scroll-offset", G_CALLBACK(on_text_entry_scrolled), NULL);
+    g_signal_connect(text_entry, "copy-clipboard", G_CALLBACK(on_text_entry_copy), NULL);
 
     gtk_widget_show_all(main_window);
     gtk_main();
+    rle_default_scheduler().log_latency();
     return 0;
 }